@@ -0,0 +1,54 @@
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include "CLR1_parser.h"
+#include "CLR1_codegen.h"
+
+// Usage: CLR1_codegen <table|ascent> <namespace> <grammar file or -> <output header>
+// The grammar file has the same format as the input of CLR1_parser: rules, then the starting nonterminal.
+int main(int argc, char **argv) {
+    if (argc != 5) {
+        std::cerr << "Usage: " << argv[0] << " <table|ascent> <namespace> <grammar file or -> <output header>\n";
+        return 1;
+    }
+    std::string backend_name = argv[1];
+    if (backend_name != "table" && backend_name != "ascent") {
+        std::cerr << "Unknown backend " << backend_name << ", use \"table\" or \"ascent\".\n";
+        return 1;
+    }
+    auto backend = backend_name == "table" ? CodegenBackend::kTable : CodegenBackend::kRecursiveAscent;
+
+    std::ifstream grammar_file;
+    std::string grammar_path = argv[3];
+    if (grammar_path != "-") {
+        grammar_file.open(grammar_path);
+        if (!grammar_file) {
+            std::cerr << "Cannot open " << grammar_path << '\n';
+            return 1;
+        }
+    }
+    std::istream &input = grammar_path == "-" ? std::cin : grammar_file;
+
+    std::vector<std::string> grammar;
+    std::string current_input;
+    while (input >> current_input) {
+        grammar.push_back(current_input);
+        if (current_input.size() == 1) {
+            break;
+        }
+    }
+
+    try {
+        Algo parser(grammar);
+        std::ofstream output(argv[4]);
+        output << GenerateParser(parser, argv[2], backend);
+        if (!output) {
+            std::cerr << "Cannot write " << argv[4] << '\n';
+            return 1;
+        }
+    } catch (std::runtime_error &error) {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
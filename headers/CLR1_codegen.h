@@ -0,0 +1,20 @@
+
+#ifndef CLR1_PARSER_CLR1_CODEGEN_H
+#define CLR1_PARSER_CLR1_CODEGEN_H
+
+#include <string>
+#include "CLR1_parser.h"
+
+enum class CodegenBackend {
+    kTable,
+    kRecursiveAscent
+};
+
+// Emits a standalone header with a parser for the grammar of the given Algo, placed in namespace `name`.
+// kTable emits constexpr action/goto arrays with an inlined driver, kRecursiveAscent emits one function per state.
+// Both define `bool Parse(std::string_view input, std::vector<int> *reductions = nullptr)`, which records
+// production ids in the order Algo::Predict records the derivation rules, and the rule strings in kRules.
+std::string GenerateParser(const Algo &parser, const std::string &name, CodegenBackend backend);
+
+#endif //CLR1_PARSER_CLR1_CODEGEN_H
+
@@ -0,0 +1,404 @@
+
+#ifndef CLR1_PARSER_CLR1_CONSTEXPR_H
+#define CLR1_PARSER_CLR1_CONSTEXPR_H
+
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include "CLR1_parser.h"
+
+// constexpr version of the Algo pipeline: ProcessInputGrammar, CalculateFirstSets, CalculateStates and MakeTable.
+// It only uses containers that are allowed in constant expressions, so it runs both at compile time and at runtime,
+// numbers the states like Algo does and throws the same GrammarException on incorrect grammars. At compile time
+// such an exception turns into a compilation error pointing at the failed check.
+class ConstexprAlgo {
+public:
+    struct Production {
+        char lhs;
+        std::string symbols;
+        size_t core_offset;
+    };
+
+    struct Item {
+        int production;
+        int dot;
+        SymbolSet lookaheads;
+
+        constexpr bool operator==(const Item &second) const = default;
+
+        constexpr bool operator<(const Item &second) const {
+            if (production != second.production) {
+                return production < second.production;
+            }
+            if (dot != second.dot) {
+                return dot < second.dot;
+            }
+            return lookaheads < second.lookaheads;
+        }
+    };
+
+    struct State {
+        std::vector<Item> kernel;
+        std::vector<Item> items;
+        std::vector<std::pair<char, int>> transitions;
+    };
+
+    std::vector<Production> productions;
+    size_t core_count = 0;
+    std::vector<char> terminals;
+    std::vector<char> nonterminals;
+    std::array<bool, 256> is_terminal{};
+    std::array<bool, 256> is_nonterminal{};
+    std::vector<SymbolSet> first_of_suffix;
+    std::vector<State> states;
+    std::array<int, 256> column{};
+    std::vector<std::uint32_t> actions;
+    std::vector<int> gotos;
+    int accept_state_id = kNoState;
+
+    constexpr explicit ConstexprAlgo(std::span<const std::string_view> grammar) {
+        ProcessInputGrammar(grammar);
+        CalculateFirstSets();
+        CalculateStates();
+        MakeTable();
+    }
+
+    constexpr void ProcessInputGrammar(std::span<const std::string_view> grammar) {
+        auto is_uppercase = [](char symbol) {
+            return symbol >= kNonTerminalAlphabetBeg && symbol <= kNonTerminalAlphabetEnd;
+        };
+        productions.push_back({kRealStart, std::string(grammar.back()), 0});
+        for (auto rule: grammar) {
+            if (rule.size() == 1) {
+                break;
+            }
+            auto delimiter_pos = rule.find("->");
+            if (delimiter_pos != 1 || !is_uppercase(rule[0])) {
+                throw GrammarException("The grammar contains incorrect LHS part.");
+            }
+            std::string symbols;
+            for (auto symbol: rule.substr(delimiter_pos + 2)) {
+                auto index = static_cast<unsigned char>(symbol);
+                if (is_uppercase(symbol)) {
+                    is_nonterminal[index] = true;
+                } else {
+                    is_terminal[index] = true;
+                }
+                if (symbol != kEpsilon) {
+                    symbols += symbol;
+                }
+            }
+            is_nonterminal[static_cast<unsigned char>(rule[0])] = true;
+            productions.push_back({rule[0], symbols, 0});
+        }
+        for (auto &production: productions) {
+            production.core_offset = core_count;
+            core_count += production.symbols.size() + 1;
+        }
+        for (int symbol = std::numeric_limits<char>::min(); symbol <= std::numeric_limits<char>::max(); ++symbol) {
+            auto index = static_cast<unsigned char>(symbol);
+            if (is_terminal[index] && symbol != kEpsilon) {
+                terminals.push_back(static_cast<char>(symbol));
+            }
+            if (is_nonterminal[index]) {
+                nonterminals.push_back(static_cast<char>(symbol));
+            }
+        }
+    }
+
+    constexpr void CalculateFirstSets() {
+        std::array<SymbolSet, 256> first;
+        auto first_of_sequence = [&](const std::string &symbols, size_t from) {
+            SymbolSet result{kEpsilon};
+            for (auto i = from; i < symbols.size(); ++i) {
+                auto symbol = static_cast<unsigned char>(symbols[i]);
+                if (!is_nonterminal[symbol]) {
+                    result.insert(symbols[i]);
+                    result.erase(kEpsilon);
+                    break;
+                }
+                auto nullable = first[symbol].contains(kEpsilon);
+                result |= first[symbol];
+                if (!nullable) {
+                    result.erase(kEpsilon);
+                    break;
+                }
+            }
+            return result;
+        };
+
+        // Plain round-robin fixed point: grammars compiled this way are small.
+        for (auto grown = true; grown;) {
+            grown = false;
+            for (size_t i = 1; i < productions.size(); ++i) {
+                auto lhs = static_cast<unsigned char>(productions[i].lhs);
+                grown |= first[lhs].Merge(first_of_sequence(productions[i].symbols, 0));
+            }
+        }
+        for (auto nonterminal: nonterminals) {
+            if (first[static_cast<unsigned char>(nonterminal)].empty()) {
+                throw GrammarException("The grammar contains useless characters.");
+            }
+        }
+
+        first_of_suffix.assign(core_count, SymbolSet());
+        for (auto &production: productions) {
+            for (size_t position = 0; position <= production.symbols.size(); ++position) {
+                first_of_suffix[production.core_offset + position] = first_of_sequence(production.symbols, position);
+            }
+        }
+    }
+
+    constexpr char SymbolAfterDot(const Item &item) const {
+        auto &symbols = productions[item.production].symbols;
+        return static_cast<size_t>(item.dot) == symbols.size() ? '\0' : symbols[item.dot];
+    }
+
+    constexpr std::vector<Item> Closure(std::vector<Item> items) const {
+        std::vector<int> position_of_core(core_count, -1);
+        std::vector<size_t> worklist;
+        for (size_t i = 0; i < items.size(); ++i) {
+            position_of_core[productions[items[i].production].core_offset + items[i].dot] = static_cast<int>(i);
+            worklist.push_back(i);
+        }
+        while (!worklist.empty()) {
+            auto item = items[worklist.back()];
+            worklist.pop_back();
+            auto symbol = SymbolAfterDot(item);
+            if (symbol == '\0' || !is_nonterminal[static_cast<unsigned char>(symbol)]) {
+                continue;
+            }
+            auto lookaheads = first_of_suffix[productions[item.production].core_offset + item.dot + 1];
+            if (lookaheads.contains(kEpsilon)) {
+                lookaheads.erase(kEpsilon);
+                lookaheads |= item.lookaheads;
+            }
+            for (size_t i = 0; i < productions.size(); ++i) {
+                if (productions[i].lhs != symbol) {
+                    continue;
+                }
+                auto &position = position_of_core[productions[i].core_offset];
+                if (position == -1) {
+                    position = static_cast<int>(items.size());
+                    items.push_back({static_cast<int>(i), 0, lookaheads});
+                    worklist.push_back(items.size() - 1);
+                } else if (items[position].lookaheads.Merge(lookaheads)) {
+                    worklist.push_back(static_cast<size_t>(position));
+                }
+            }
+        }
+        std::sort(items.begin(), items.end());
+        return items;
+    }
+
+    constexpr int AddState(std::vector<Item> kernel) {
+        State state;
+        state.items = Closure(kernel);
+        state.kernel = std::move(kernel);
+        states.push_back(std::move(state));
+        return static_cast<int>(states.size()) - 1;
+    }
+
+    constexpr void CalculateStates() {
+        AddState({{0, 0, SymbolSet{kEndOfLine}}});
+        if (states.back().items.size() == 1) {
+            throw GrammarException("The grammar is incorrect. There are no reachable symbols.");
+        }
+        // Terminals first, then nonterminals, each in alphabetical order, as in Algo::SuccessorKernels.
+        std::vector<char> symbols = terminals;
+        symbols.insert(symbols.end(), nonterminals.begin(), nonterminals.end());
+        for (size_t i = 0; i < states.size(); ++i) {
+            for (auto symbol: symbols) {
+                std::vector<Item> kernel;
+                for (auto &item: states[i].items) {
+                    if (SymbolAfterDot(item) == symbol) {
+                        kernel.push_back({item.production, item.dot + 1, item.lookaheads});
+                    }
+                }
+                if (kernel.empty()) {
+                    continue;
+                }
+                std::sort(kernel.begin(), kernel.end());
+                auto target = kNoState;
+                for (size_t j = 0; j < states.size() && target == kNoState; ++j) {
+                    if (states[j].kernel == kernel) {
+                        target = static_cast<int>(j);
+                    }
+                }
+                if (target == kNoState) {
+                    target = AddState(std::move(kernel));
+                }
+                states[i].transitions.emplace_back(symbol, target);
+            }
+        }
+        for (auto [symbol, target]: states[0].transitions) {
+            if (symbol == productions[0].symbols[0]) {
+                accept_state_id = target;
+            }
+        }
+    }
+
+    constexpr void MakeTable() {
+        column.fill(kNoColumn);
+        for (size_t i = 0; i < terminals.size(); ++i) {
+            column[static_cast<unsigned char>(terminals[i])] = static_cast<int>(i);
+        }
+        column[static_cast<unsigned char>(kEndOfLine)] = static_cast<int>(terminals.size());
+        for (size_t i = 0; i < nonterminals.size(); ++i) {
+            column[static_cast<unsigned char>(nonterminals[i])] = static_cast<int>(i);
+        }
+        auto terminal_count = TerminalCount();
+        actions.assign(states.size() * terminal_count, ParseTable::MakeAction(ActionType::kError));
+        gotos.assign(states.size() * nonterminals.size(), kNoState);
+        for (size_t state = 0; state < states.size(); ++state) {
+            for (auto [symbol, target]: states[state].transitions) {
+                auto symbol_column = column[static_cast<unsigned char>(symbol)];
+                if (is_nonterminal[static_cast<unsigned char>(symbol)]) {
+                    gotos[state * nonterminals.size() + symbol_column] = target;
+                } else {
+                    actions[state * terminal_count + symbol_column] = ParseTable::MakeAction(ActionType::kShift, target);
+                }
+            }
+            for (auto &item: states[state].items) {
+                if (SymbolAfterDot(item) != '\0') {
+                    continue;
+                }
+                auto action = item.production == 0 ? ParseTable::MakeAction(ActionType::kAccept)
+                                                   : ParseTable::MakeAction(ActionType::kReduce, item.production);
+                for (auto lookahead: item.lookaheads) {
+                    auto lookahead_column = column[static_cast<unsigned char>(lookahead)];
+                    if (lookahead_column == kNoColumn) {
+                        continue;
+                    }
+                    auto &cell = actions[state * terminal_count + lookahead_column];
+                    if (ParseTable::TypeOf(cell) == ActionType::kShift) {
+                        throw GrammarException("Shift/Reduce conflict occurred. The grammar is no LR(1) type.");
+                    }
+                    if (ParseTable::TypeOf(cell) != ActionType::kError) {
+                        throw GrammarException("Reduce/Reduce conflict occurred. The grammar is no LR(1) type.");
+                    }
+                    cell = action;
+                }
+            }
+        }
+    }
+
+    constexpr size_t TerminalCount() const {
+        return terminals.size() + 1;
+    }
+};
+
+// Parse table computed at compile time. Array sizes come from a first run of ConstexprAlgo, so the object
+// lives entirely in read-only data and needs neither heap memory nor any work at startup.
+template<size_t StateCount, size_t TerminalCount, size_t NonTerminalCount, size_t ProductionCount>
+class StaticParser {
+public:
+    std::array<int, 256> column{};
+    std::array<std::uint32_t, StateCount * TerminalCount> actions{};
+    std::array<int, StateCount * NonTerminalCount> gotos{};
+    std::array<std::uint32_t, ProductionCount> production_lengths{};
+    std::array<int, ProductionCount> production_lhs{};
+    int accept_state_id = kNoState;
+
+    constexpr TableView View() const {
+        TableView view;
+        view.column = column.data();
+        view.state_count = StateCount;
+        view.terminal_count = TerminalCount;
+        view.nonterminal_count = NonTerminalCount;
+        view.actions = actions.data();
+        view.gotos = gotos.data();
+        view.production_lengths = production_lengths.data();
+        view.production_lhs = production_lhs.data();
+        return view;
+    }
+
+    // Depth of the state stack that Parse keeps on the call stack when no buffer is given.
+    static constexpr size_t kDefaultStackDepth = 1024;
+
+    // Same semantics as Algo::Predict, but records production ids instead of rule strings.
+    constexpr bool Parse(std::string_view input, std::vector<int> *reductions = nullptr) const {
+        std::array<int, kDefaultStackDepth> stack{};
+        return Parse(input, stack, reductions);
+    }
+
+    // Keeps the state stack in the caller's buffer. The depth needed grows with the nesting of the word, so no
+    // size fits every input of a recursive grammar; a word that needs more throws std::length_error.
+    constexpr bool Parse(std::string_view input, std::span<int> stack, std::vector<int> *reductions = nullptr) const {
+        if (input.size() == 1 && input[0] == kEpsilon) {
+            input = {};
+        }
+        size_t depth = 0;
+        auto push = [&stack, &depth](int state) {
+            if (depth == stack.size()) {
+                throw std::length_error("The word nests deeper than the parser stack.");
+            }
+            stack[depth++] = state;
+        };
+        push(0);
+        for (size_t position = 0; position <= input.size(); ++position) {
+            auto symbol = position == input.size() ? kEndOfLine : input[position];
+            if (symbol == kEndOfLine && position != input.size()) {
+                return false;
+            }
+            auto symbol_column = column[static_cast<unsigned char>(symbol)];
+            if (symbol_column == kNoColumn) {
+                return false;
+            }
+            auto action = actions[stack[depth - 1] * TerminalCount + symbol_column];
+            while (ParseTable::TypeOf(action) == ActionType::kReduce) {
+                auto production = ParseTable::ValueOf(action);
+                if (reductions != nullptr) {
+                    reductions->push_back(production);
+                }
+                depth -= production_lengths[production];
+                auto next_state = gotos[stack[depth - 1] * NonTerminalCount + production_lhs[production]];
+                if (next_state == kNoState) {
+                    return false;
+                }
+                push(next_state);
+                action = actions[stack[depth - 1] * TerminalCount + symbol_column];
+            }
+            switch (ParseTable::TypeOf(action)) {
+                case ActionType::kShift:
+                    push(ParseTable::ValueOf(action));
+                    break;
+                case ActionType::kAccept:
+                    if (reductions != nullptr) {
+                        reductions->push_back(0);
+                    }
+                    return true;
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+};
+
+// Usage:
+//     static constexpr std::string_view kGrammar[] = {"S->(S)S", "S->~", "S"};
+//     static constexpr auto kParser = CompileGrammar<kGrammar>();
+//     static_assert(kParser.Parse("(())()"));
+template<const auto &Grammar>
+consteval auto CompileGrammar() {
+    constexpr auto kSizes = [] {
+        ConstexprAlgo algo(Grammar);
+        return std::array<size_t, 4>{algo.states.size(), algo.TerminalCount(), algo.nonterminals.size(),
+                                     algo.productions.size()};
+    }();
+    StaticParser<kSizes[0], kSizes[1], kSizes[2], kSizes[3]> parser;
+    ConstexprAlgo algo(Grammar);
+    parser.column = algo.column;
+    std::copy(algo.actions.begin(), algo.actions.end(), parser.actions.begin());
+    std::copy(algo.gotos.begin(), algo.gotos.end(), parser.gotos.begin());
+    for (size_t i = 0; i < algo.productions.size(); ++i) {
+        parser.production_lengths[i] = static_cast<std::uint32_t>(algo.productions[i].symbols.size());
+        parser.production_lhs[i] = algo.column[static_cast<unsigned char>(algo.productions[i].lhs)];
+    }
+    parser.accept_state_id = algo.accept_state_id;
+    return parser;
+}
+
+#endif //CLR1_PARSER_CLR1_CONSTEXPR_H
@@ -1,93 +1,992 @@
-
-#ifndef CLR1_PARSER_CLR1_PARSER_H
-#define CLR1_PARSER_CLR1_PARSER_H
-
-#include <iostream>
-#include <cctype>
-#include <set>
-#include <map>
-#include <vector>
-#include <iomanip>
-#include <stack>
-#include <exception>
-
-class GrammarException : public std::runtime_error {
-public:
-    explicit GrammarException(std::string message) : runtime_error(message) {
-    }
-};
-
-class NonTerminal {
-public:
-    char symbol;
-    std::set<char> first = std::set<char>();
-    NonTerminal() = default;
-    explicit NonTerminal(char input_symbol) : symbol(input_symbol) {
-    }
-};
-
-class Item {
-public:
-    char lhs;
-    std::string rhs;
-    std::set<char> lookaheads;
-    Item(char rule_lhs, std::string rule_rhs, int dot_pos, const std::set<char> &new_lookaheads);
-    Item(char rule_lhs, std::string rule_rhs_with_dot, const std::set<char> &new_lookaheads);
-    bool operator==(Item &second);
-    bool operator<(Item &second);
-    bool operator!=(Item &second);
-};
-
-class State {
-public:
-    static int counter_id;
-    int personal_id;
-    std::vector<Item> items;
-    std::map<char, int> transitions;
-    explicit State(const std::vector<Item> &new_items);
-};
-
-struct ParseType {
-    bool is_shift;
-    std::string value;
-};
-
-auto const kRealStart = '@';
-auto const kEndOfLine = '$';
-auto const kEpsilon = '~';
-auto const kNonTerminalAlphabetBeg = 65;
-auto const kNonTerminalAlphabetEnd = 90;
-
-class Algo {
-public:
-    using ProductionRulesType = std::map<char, std::vector<std::string>>;
-    using TerminalSetType = std::set<char>;
-    using NonTerminalSetType = std::map<char, NonTerminal>;
-    using AutomatonType = std::vector<State>;
-    using TableType = std::vector<std::map<char, std::string>>;
-
-    ProductionRulesType production_rules;
-    TerminalSetType terminals;
-    NonTerminalSetType nonterminals;
-    AutomatonType states;
-    TableType table;
-    int accept_state_id;
-    explicit Algo(std::vector<std::string> &grammar);
-    void Fit(std::vector<std::string> &grammar);
-    void ProcessInputGrammar(std::vector<std::string> &grammar);
-    std::set<char> CalculateFirstOfSymbol(char curr_symbol, std::set<char> &symbols_in_lhs);
-    std::set<char> CalculateFirstOfChain(std::string chain);
-    bool ItemIsInSet(Item &curr_item, std::vector<Item> &items);
-    std::vector<Item> Closure(std::vector<Item> items);
-    std::vector<Item> Transition(State &state, char symbol);
-    int StateAlreadyExists(std::vector<Item> &curr_state);
-    void CalculateStates();
-    void MakeTable();
-    bool Predict(std::string input, std::vector<std::string> &derivation_rules);
-};
-
-std::string CalculateDerivation(const std::vector<std::string> &derivation_rules);
-void PrintStates(const Algo &parser);
-void PrintTable(Algo &parser);
-
-#endif //CLR1_PARSER_CLR1_PARSER_H
+
+#ifndef CLR1_PARSER_CLR1_PARSER_H
+#define CLR1_PARSER_CLR1_PARSER_H
+
+#include <iostream>
+#include <cctype>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <iomanip>
+#include <stack>
+#include <exception>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <bit>
+#include <string_view>
+#include <coroutine>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <span>
+
+class GrammarException : public std::runtime_error {
+public:
+    explicit GrammarException(std::string message) : runtime_error(message) {
+    }
+};
+
+class TableFileException : public std::runtime_error {
+public:
+    explicit TableFileException(std::string message) : runtime_error(message) {
+    }
+};
+
+class SymbolSet {
+public:
+    static auto const kWordBits = 64;
+    static auto const kWordsNumber = 256 / kWordBits;
+
+    class Iterator {
+    public:
+        using value_type = char;
+        using difference_type = std::ptrdiff_t;
+
+        constexpr Iterator() = default;
+        constexpr Iterator(const SymbolSet *set, int position) : set_(set), position_(position) {
+            Advance();
+        }
+
+        constexpr char operator*() const {
+            return static_cast<char>(position_);
+        }
+
+        constexpr Iterator &operator++() {
+            ++position_;
+            Advance();
+            return *this;
+        }
+
+        constexpr Iterator operator++(int) {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        constexpr bool operator==(const Iterator &second) const {
+            return position_ == second.position_;
+        }
+
+    private:
+        constexpr void Advance() {
+            while (position_ < kWordsNumber * kWordBits) {
+                auto rest = set_->words[position_ / kWordBits] >> (position_ % kWordBits);
+                if (rest != 0) {
+                    position_ += std::countr_zero(rest);
+                    return;
+                }
+                position_ += kWordBits - position_ % kWordBits;
+            }
+        }
+
+        const SymbolSet *set_ = nullptr;
+        int position_ = kWordsNumber * kWordBits;
+    };
+
+    std::array<std::uint64_t, kWordsNumber> words{};
+
+    constexpr SymbolSet() = default;
+    constexpr SymbolSet(std::initializer_list<char> symbols) {
+        for (auto symbol: symbols) {
+            insert(symbol);
+        }
+    }
+
+    constexpr void insert(char symbol) {
+        auto index = static_cast<unsigned char>(symbol);
+        words[index / kWordBits] |= std::uint64_t{1} << (index % kWordBits);
+    }
+
+    constexpr void erase(char symbol) {
+        auto index = static_cast<unsigned char>(symbol);
+        words[index / kWordBits] &= ~(std::uint64_t{1} << (index % kWordBits));
+    }
+
+    constexpr bool contains(char symbol) const {
+        auto index = static_cast<unsigned char>(symbol);
+        return (words[index / kWordBits] >> (index % kWordBits)) & 1;
+    }
+
+    constexpr bool empty() const {
+        std::uint64_t any = 0;
+        for (auto word: words) {
+            any |= word;
+        }
+        return any == 0;
+    }
+
+    constexpr size_t size() const {
+        size_t count = 0;
+        for (auto word: words) {
+            count += std::popcount(word);
+        }
+        return count;
+    }
+
+    // Returns whether the set has grown.
+    constexpr bool Merge(const SymbolSet &second) {
+        std::uint64_t grown = 0;
+        for (int i = 0; i < kWordsNumber; ++i) {
+            grown |= second.words[i] & ~words[i];
+            words[i] |= second.words[i];
+        }
+        return grown != 0;
+    }
+
+    constexpr SymbolSet &operator|=(const SymbolSet &second) {
+        Merge(second);
+        return *this;
+    }
+
+    constexpr size_t Hash() const {
+        std::uint64_t hash = 0;
+        for (auto word: words) {
+            hash = (hash ^ word) * 0x100000001b3ULL;
+            hash ^= hash >> 29;
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    constexpr bool operator==(const SymbolSet &second) const = default;
+
+    constexpr bool operator<(const SymbolSet &second) const {
+        return words < second.words;
+    }
+
+    constexpr Iterator begin() const {
+        return {this, 0};
+    }
+
+    constexpr Iterator end() const {
+        return {};
+    }
+};
+
+class NonTerminal {
+public:
+    char symbol;
+    SymbolSet first;
+    NonTerminal() = default;
+    explicit NonTerminal(char input_symbol) : symbol(input_symbol) {
+    }
+};
+
+class Item {
+public:
+    int production;
+    int dot;
+    SymbolSet lookaheads;
+    Item(int production_id, int dot_pos, const SymbolSet &new_lookaheads);
+    bool operator==(const Item &second) const;
+    bool operator<(const Item &second) const;
+    bool operator!=(const Item &second) const;
+};
+
+class State {
+public:
+    int personal_id;
+    std::vector<Item> items;
+    std::map<char, int> transitions;
+    State(const std::vector<Item> &new_items, int id);
+    static std::string Fingerprint(const std::vector<Item> &canonical_items);
+    static std::vector<Item> Kernel(const std::vector<Item> &closure_items);
+};
+
+class CoreClosure {
+public:
+    struct Edge {
+        int source;
+        int target;
+    };
+
+    std::vector<int> productions;
+    std::vector<Edge> edges;
+    bool needs_fixed_point = false;
+};
+
+struct ConstructionStats {
+    size_t kernel_hits = 0;
+    size_t kernel_misses = 0;
+    size_t core_closure_hits = 0;
+    size_t core_closure_misses = 0;
+    size_t canonical_states = 0;
+    size_t merged_states = 0;
+    // States whose closure was taken over from the automaton before a grammar edit.
+    size_t reused_states = 0;
+};
+
+enum class ConstructionMode {
+    kCanonical,
+    kMinimal,
+    // Canonical states, built one at a time the first time a parse reaches them.
+    kLazy
+};
+
+struct BuildOptions {
+    // Threads for the canonical automaton. Lazy construction builds one row at a time and ignores it.
+    unsigned threads = 1;
+    ConstructionMode mode = ConstructionMode::kCanonical;
+    // Parse with a CompressedTable built from the dense table. Not available with lazy construction.
+    bool compress_table = false;
+    // Keep conflicting actions in kConflict cells instead of throwing; such tables are parsed by the GLR driver.
+    // Not available with lazy construction.
+    bool glr = false;
+};
+
+class Production {
+public:
+    char lhs;
+    std::string rhs;
+    std::string symbols;
+    size_t length;
+    size_t core_offset = 0;
+    std::string rule;
+    Production(char rule_lhs, const std::string &rule_rhs);
+};
+
+enum class ActionType : std::uint32_t {
+    kError = 0,
+    kShift = 1,
+    kReduce = 2,
+    kAccept = 3,
+    // Several actions, listed in ParseTable::conflicts at the cell value. Only GLR tables have them.
+    kConflict = 4
+};
+
+auto const kActionTypeBits = 3;
+auto const kActionTypeMask = (1u << kActionTypeBits) - 1;
+auto const kNoColumn = -1;
+auto const kNoState = -1;
+
+class TableView {
+public:
+    const int *column = nullptr;
+    size_t state_count = 0;
+    size_t terminal_count = 0;
+    size_t nonterminal_count = 0;
+    const std::uint32_t *actions = nullptr;
+    const int *gotos = nullptr;
+    const std::uint32_t *production_lengths = nullptr;
+    const int *production_lhs = nullptr;
+
+    int Column(char symbol) const {
+        return column[static_cast<unsigned char>(symbol)];
+    }
+
+    std::uint32_t Action(int state, int terminal_column) const {
+        return actions[state * terminal_count + terminal_column];
+    }
+
+    int Goto(int state, int nonterminal_column) const {
+        return gotos[state * nonterminal_count + nonterminal_column];
+    }
+};
+
+class ParseTable {
+public:
+    using ActionCell = std::uint32_t;
+
+    std::array<int, 256> column;
+    size_t state_count = 0;
+    size_t terminal_count = 0;
+    size_t nonterminal_count = 0;
+    std::vector<ActionCell> actions;
+    std::vector<int> gotos;
+    std::vector<std::uint32_t> production_lengths;
+    std::vector<int> production_lhs;
+    std::vector<std::vector<ActionCell>> conflicts;
+    ParseTable();
+    ParseTable(size_t states_number, const std::set<char> &terminals, const std::vector<char> &nonterminals);
+
+    static constexpr ActionCell MakeAction(ActionType type, int value = 0) {
+        return (static_cast<ActionCell>(value) << kActionTypeBits) | static_cast<ActionCell>(type);
+    }
+
+    static constexpr ActionType TypeOf(ActionCell cell) {
+        return static_cast<ActionType>(cell & kActionTypeMask);
+    }
+
+    static constexpr int ValueOf(ActionCell cell) {
+        return static_cast<int>(cell >> kActionTypeBits);
+    }
+
+    int Column(char symbol) const {
+        return column[static_cast<unsigned char>(symbol)];
+    }
+
+    ActionCell &Action(int state, int terminal_column) {
+        return actions[state * terminal_count + terminal_column];
+    }
+
+    ActionCell Action(int state, int terminal_column) const {
+        return actions[state * terminal_count + terminal_column];
+    }
+
+    int &Goto(int state, int nonterminal_column) {
+        return gotos[state * nonterminal_count + nonterminal_column];
+    }
+
+    int Goto(int state, int nonterminal_column) const {
+        return gotos[state * nonterminal_count + nonterminal_column];
+    }
+
+    TableView View() const;
+};
+
+// Compressed form of a parse table with the same lookup interface as TableView.
+// Every state gets its most frequent reduction as the default action and only the other non-error entries are
+// stored, packed row by row into a comb vector: row r lives at slots action_base[r] + column, which are marked
+// with r in action_check. Goto rows are packed the same way. A bit matrix keeps the error entries, so errors
+// are detected exactly where the dense table detects them instead of after some default reductions.
+class CompressedTable {
+public:
+    using ActionCell = ParseTable::ActionCell;
+
+    std::array<int, 256> column;
+    size_t state_count = 0;
+    size_t terminal_count = 0;
+    size_t nonterminal_count = 0;
+    std::vector<ActionCell> default_actions;
+    std::vector<int> action_base;
+    std::vector<ActionCell> packed_actions;
+    std::vector<int> action_check;
+    std::vector<int> goto_base;
+    std::vector<int> packed_gotos;
+    std::vector<int> goto_check;
+    std::vector<std::uint64_t> error_bits;
+    std::vector<std::uint32_t> production_lengths;
+    std::vector<int> production_lhs;
+    explicit CompressedTable(const TableView &table_view, size_t production_count);
+
+    int Column(char symbol) const {
+        return column[static_cast<unsigned char>(symbol)];
+    }
+
+    ActionCell Action(int state, int terminal_column) const {
+        auto bit = static_cast<size_t>(state) * terminal_count + terminal_column;
+        if ((error_bits[bit / 64] >> (bit % 64)) & 1) {
+            return ParseTable::MakeAction(ActionType::kError);
+        }
+        auto slot = action_base[state] + terminal_column;
+        return action_check[slot] == state ? packed_actions[slot] : default_actions[state];
+    }
+
+    int Goto(int state, int nonterminal_column) const {
+        auto slot = goto_base[state] + nonterminal_column;
+        return goto_check[slot] == state ? packed_gotos[slot] : kNoState;
+    }
+
+    // Size of the dense action and goto arrays this table replaces.
+    size_t RawBytes() const;
+    size_t Bytes() const;
+};
+
+// Read-only memory mapping of a parse table file written by SaveTable.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    const char *data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+auto const kTableFileMagic = "CLR1TBL";
+auto const kTableFileVersion = 2u;
+
+// All fields and arrays of the file are little-endian, every array starts at an 8-byte aligned offset.
+struct TableFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t state_count;
+    std::uint32_t terminal_count;
+    std::uint32_t nonterminal_count;
+    std::uint32_t production_count;
+    std::int32_t accept_state;
+    std::uint64_t grammar_hash;
+    std::uint64_t columns_offset;
+    std::uint64_t actions_offset;
+    std::uint64_t gotos_offset;
+    std::uint64_t lengths_offset;
+    std::uint64_t lhs_offset;
+    std::uint64_t file_size;
+};
+
+// Minimal C++20 coroutine generator: the coroutine runs up to its next co_yield whenever the iterator advances.
+template<typename T>
+class Generator {
+public:
+    struct promise_type {
+        const T *current = nullptr;
+
+        Generator get_return_object() {
+            return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_always yield_value(const T &value) noexcept {
+            current = &value;
+            return {};
+        }
+
+        void return_void() {
+        }
+
+        void unhandled_exception() {
+            throw;
+        }
+    };
+
+    class Iterator {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+        explicit Iterator(std::coroutine_handle<promise_type> handle) : handle_(handle) {
+        }
+
+        const T &operator*() const {
+            return *handle_.promise().current;
+        }
+
+        Iterator &operator++() {
+            handle_.resume();
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const {
+            return handle_.done();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    explicit Generator(std::coroutine_handle<promise_type> handle) : handle_(handle) {
+    }
+
+    Generator(Generator &&second) noexcept : handle_(std::exchange(second.handle_, {})) {
+    }
+
+    Generator(const Generator &) = delete;
+    Generator &operator=(const Generator &) = delete;
+
+    ~Generator() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    Iterator begin() {
+        handle_.resume();
+        return Iterator(handle_);
+    }
+
+    std::default_sentinel_t end() const {
+        return {};
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// Reduction by `production` of the input characters [begin, end). The accepting reduction by production 0
+// spans the whole word and is always the last event of an accepted word.
+struct ReduceEvent {
+    int production;
+    size_t begin;
+    size_t end;
+
+    bool operator==(const ReduceEvent &second) const = default;
+};
+
+using ReduceCallback = std::function<void(const ReduceEvent &)>;
+
+// Caller-owned state of Algo::Parse. The stack and the reductions keep their capacity between calls,
+// so parsing words no longer than the ones seen before does not allocate.
+class ParseContext {
+public:
+    static auto const kDefaultStackCapacity = 64;
+
+    std::vector<int> stack;
+    std::vector<size_t> span_starts;
+    std::vector<int> reductions;
+    explicit ParseContext(size_t stack_capacity = kDefaultStackCapacity);
+};
+
+struct RecognizeResult {
+    static auto const kNoError = std::string_view::npos;
+
+    bool accepted = false;
+    // Offset of the first character the automaton could not handle, input size for an unexpected end of the word.
+    size_t error_offset = kNoError;
+};
+
+class Algo;
+
+// Immutable compiled form of an Algo: the parse table, owned or mapped from a table file, and the rule strings.
+// All methods are const and keep the parse state in the caller's ParseContext, so threads can share one instance.
+class CompiledParser {
+public:
+    CompiledParser(ParseTable parse_table, std::vector<std::string> production_rules);
+    CompiledParser(std::shared_ptr<const MappedFile> file, const TableView &file_view,
+                   std::vector<std::string> production_rules);
+    TableView View() const;
+    const std::string &Rule(int production) const;
+    bool Parse(std::string_view input, ParseContext &context) const;
+    bool Parse(std::string_view input, ParseContext &context, const ReduceCallback &on_reduce) const;
+    // The input must outlive the generator.
+    Generator<ReduceEvent> ReduceEvents(std::string_view input) const;
+    RecognizeResult Recognize(std::string_view input, ParseContext &context) const;
+
+private:
+    ParseTable table_;
+    std::shared_ptr<const MappedFile> table_file_;
+    TableView table_file_view_;
+    std::vector<std::string> rules_;
+};
+
+auto const kBatchChunkSize = 1024;
+
+// Recognizes the words on a pool of threads sharing the parser. Results are in the order of the words.
+std::vector<RecognizeResult> ParseBatch(const CompiledParser &parser, const std::vector<std::string> &words,
+                                        unsigned threads = std::thread::hardware_concurrency());
+
+enum class PushStatus {
+    kNeedMoreInput,
+    kAccepted,
+    kRejected
+};
+
+// Incremental LR driver for words that arrive in chunks. The state stack survives between Feed calls and no input
+// is buffered, so memory is bounded by the stack depth. The parser whose table is used must outlive this object.
+class PushParser {
+public:
+    explicit PushParser(const Algo &parser);
+    explicit PushParser(const CompiledParser &parser);
+    PushStatus Feed(std::string_view chunk);
+    PushStatus Finish();
+    void Reset();
+
+    PushStatus Status() const {
+        return status_;
+    }
+
+    // Offset of the first offending character in the whole word, RecognizeResult::kNoError while there is none.
+    size_t ErrorOffset() const {
+        return error_offset_;
+    }
+
+    size_t Consumed() const {
+        return consumed_;
+    }
+
+private:
+    explicit PushParser(const TableView &table_view);
+    void Step(char symbol);
+
+    TableView table_view_;
+    std::vector<int> stack_;
+    size_t consumed_ = 0;
+    size_t error_offset_ = RecognizeResult::kNoError;
+    bool pending_epsilon_ = false;
+    PushStatus status_ = PushStatus::kNeedMoreInput;
+};
+
+// Recognizes a document and keeps the result current across edits. Every checkpoint_interval characters the state
+// stack is recorded; the stack at an offset depends only on the text before it. Stacks live in one arena of
+// (state, parent) nodes shared by all checkpoints, so a checkpoint is just its top node. An edit resumes from the
+// last checkpoint before it and stops at the first checkpoint after it whose recorded stack the new run reproduces:
+// from there on the old run repeats itself, so its result is reused. Checkpoints past an error introduced by an
+// edit are kept, so fixing the error converges as quickly. The parser whose table is used must outlive this object.
+class ParseSession {
+public:
+    static constexpr size_t kDefaultCheckpointInterval = 256;
+
+    explicit ParseSession(const Algo &parser, size_t checkpoint_interval = kDefaultCheckpointInterval);
+    explicit ParseSession(const CompiledParser &parser, size_t checkpoint_interval = kDefaultCheckpointInterval);
+    RecognizeResult Reset(std::string text);
+    // Replaces `erased` characters at `offset` with `inserted`.
+    RecognizeResult Edit(size_t offset, size_t erased, std::string_view inserted);
+
+    const std::string &Text() const {
+        return text_;
+    }
+
+    RecognizeResult Result() const {
+        return result_;
+    }
+
+    // Characters the automaton read during the last Reset or Edit.
+    size_t LastScanned() const {
+        return last_scanned_;
+    }
+
+    size_t CheckpointCount() const {
+        return checkpoints_.size();
+    }
+
+private:
+    static constexpr std::uint32_t kNoParent = std::numeric_limits<std::uint32_t>::max();
+    static constexpr size_t kMinArenaSize = 1024;
+
+    struct StackNode {
+        int state;
+        std::uint32_t parent;
+    };
+
+    struct Checkpoint {
+        size_t offset;
+        std::uint32_t node;
+        std::uint32_t depth;
+    };
+
+    ParseSession(const TableView &table_view, size_t checkpoint_interval);
+    void Run(std::vector<Checkpoint> tail, RecognizeResult tail_result);
+    bool SameStack(const Checkpoint &checkpoint, std::uint32_t top, std::uint32_t depth) const;
+    void CompactNodes();
+
+    TableView table_view_;
+    size_t checkpoint_interval_;
+    std::string text_;
+    std::vector<StackNode> nodes_;
+    std::vector<Checkpoint> checkpoints_;
+    // Unmatched checkpoints of an earlier run that went past the current error, and where that run ended.
+    std::vector<Checkpoint> stale_;
+    RecognizeResult stale_result_;
+    RecognizeResult result_;
+    size_t live_nodes_ = 1;
+    size_t last_scanned_ = 0;
+};
+
+// Node of a ParseTree. Spans are offsets into the parsed word, which is limited to 4 GiB.
+struct ParseTreeNode {
+    // Production id of an inner node or ParseTree::kTokenNode for a leaf holding one input character.
+    std::int32_t production;
+    // Distance back to the first node of the subtree, 0 for leaves and empty productions.
+    std::uint32_t child_offset;
+    std::uint32_t begin;
+    std::uint32_t end;
+};
+
+// Read-only parse tree, either over a ParseTree or over a mapped tree file.
+class ParseTreeView {
+public:
+    std::span<const ParseTreeNode> nodes;
+    std::shared_ptr<const MappedFile> file;
+
+    const ParseTreeNode &Root() const {
+        return nodes.back();
+    }
+};
+
+// Parse tree laid out in post-order: the children of a node precede it, so the subtree of node i is
+// [i - child_offset, i] and a whole-tree traversal is a linear scan. The node buffer works as a bump arena:
+// nodes are only appended during a parse and Clear keeps the capacity for the next one. Since the nodes are
+// plain fixed-width records, Save writes the buffer as is and MapParseTree uses the mapped file without copying.
+class ParseTree {
+public:
+    static auto const kTokenNode = -1;
+
+    std::vector<ParseTreeNode> nodes;
+
+    void Clear() {
+        nodes.clear();
+    }
+
+    const ParseTreeNode &Root() const {
+        return nodes.back();
+    }
+
+    ParseTreeView View() const {
+        return {nodes, nullptr};
+    }
+
+    void Save(const std::string &path) const;
+};
+
+auto const kParseTreeFileMagic = "CLR1TRE";
+auto const kParseTreeFileVersion = 1u;
+
+// The nodes follow the header immediately, in the byte order of the machine, which must be little-endian.
+struct ParseTreeFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t node_size;
+    std::uint64_t node_count;
+};
+
+ParseTreeView MapParseTree(const std::string &path);
+
+// One way to derive a ParseForest node: a production and its right-hand side nodes, left to right.
+struct ForestAlternative {
+    int production;
+    std::uint32_t first_child;
+    std::uint32_t child_count;
+    int next;
+};
+
+// Nonterminal or token of a ParseForest over the word span [begin, end). Tokens have no alternatives.
+struct ForestNode {
+    char symbol;
+    std::uint32_t begin;
+    std::uint32_t end;
+    int first_alternative;
+};
+
+// Shared packed parse forest built by the GLR driver. Parses that agree on a symbol and its span share one node,
+// and a node lists every way to derive it as alternatives, so the forest stays polynomial even when the number
+// of trees is exponential. The root stands for the real start symbol over the whole word.
+class ParseForest {
+public:
+    static constexpr auto kNoNode = -1;
+
+    std::vector<ForestNode> nodes;
+    std::vector<ForestAlternative> alternatives;
+    std::vector<std::uint32_t> children;
+    int root = kNoNode;
+
+    void Clear();
+    bool IsAmbiguous() const;
+    // Number of parse trees, saturated at the largest uint64 value, which also stands for infinitely many.
+    std::uint64_t CountTrees() const;
+    // Productions of one of the trees in the order Parse records them, the accepting production 0 last.
+    bool FirstDerivation(std::vector<int> &reductions) const;
+};
+
+// Rightmost derivation of a parsed word, rendered only when asked for. Built from the production ids that
+// Parse records; ToString returns the same text as CalculateDerivation without rescanning the rule strings.
+class DerivationView {
+public:
+    DerivationView(const Algo &parser, std::vector<int> reductions);
+
+    // Number of derivation steps.
+    size_t size() const {
+        return reductions_.size();
+    }
+
+    std::string ToString() const;
+
+private:
+    const Algo &parser_;
+    std::vector<int> reductions_;
+};
+
+// Parse table of the canonical automaton that is built while parsing. Only the start state exists up front;
+// the row of a state, and with it the kernels of its successors, is computed on the first lookup and kept.
+// Lookups of built rows take no lock: rows are published through atomic pointers and state slots live in
+// chunks that never move, so any number of threads may parse with one table. Conflicts throw GrammarException
+// from the lookup that runs into them. References the Algo that owns it.
+class LazyTable {
+public:
+    using ActionCell = ParseTable::ActionCell;
+
+    static auto const kChunkBits = 10;
+    static auto const kChunkSize = 1 << kChunkBits;
+    static auto const kMaxChunks = 4096;
+
+    std::array<int, 256> column;
+    size_t terminal_count = 0;
+    size_t nonterminal_count = 0;
+    std::vector<std::uint32_t> production_lengths;
+    std::vector<int> production_lhs;
+    explicit LazyTable(const Algo &parser);
+
+    int Column(char symbol) const {
+        return column[static_cast<unsigned char>(symbol)];
+    }
+
+    ActionCell Action(int state, int terminal_column) const {
+        return RowOf(state).actions[terminal_column];
+    }
+
+    int Goto(int state, int nonterminal_column) const {
+        return RowOf(state).gotos[nonterminal_column];
+    }
+
+    // States discovered so far and the part of them whose rows are built.
+    size_t StateCount() const;
+    size_t BuiltRowCount() const;
+
+private:
+    struct Row {
+        std::vector<ActionCell> actions;
+        std::vector<int> gotos;
+    };
+
+    struct LazyState {
+        std::vector<Item> items;
+        std::unique_ptr<const Row> owned_row;
+        std::atomic<const Row *> row = nullptr;
+    };
+
+    const Row &RowOf(int state) const {
+        auto *chunk = chunks_[state >> kChunkBits].load(std::memory_order_acquire);
+        auto *row = chunk[state & (kChunkSize - 1)].row.load(std::memory_order_acquire);
+        return row != nullptr ? *row : BuildRow(state);
+    }
+
+    const Row &BuildRow(int state) const;
+    int FindOrAddState(std::vector<Item> kernel) const;
+
+    std::shared_ptr<const Algo> grammar_;
+    // Everything below is filled in by const lookups; writers hold mutex_.
+    mutable std::mutex mutex_;
+    mutable std::unique_ptr<std::atomic<LazyState *>[]> chunks_;
+    mutable std::vector<std::unique_ptr<LazyState[]>> owned_chunks_;
+    mutable std::unordered_map<std::string, int> state_index_;
+    mutable std::unordered_map<std::string, CoreClosure> core_closures_;
+    mutable ConstructionStats stats_;
+    mutable size_t state_count_ = 0;
+    mutable size_t built_row_count_ = 0;
+};
+
+// Visit counts collected by ProfileStates: how often every state was pushed on the stack and how often
+// every (from, to) transition, by shift or by goto, was taken.
+struct StateProfile {
+    std::vector<std::uint64_t> visits;
+    std::map<std::pair<int, int>, std::uint64_t> transitions;
+};
+
+auto const kRealStart = '@';
+auto const kEndOfLine = '$';
+auto const kEpsilon = '~';
+auto const kDeclarationPrefix = '%';
+auto const kNonTerminalAlphabetBeg = 65;
+auto const kNonTerminalAlphabetEnd = 90;
+
+enum class Associativity {
+    kLeft,
+    kRight,
+    kNonAssoc
+};
+
+// Declared by a "%left+-", "%right^" or "%nonassoc<" grammar line; later lines bind tighter.
+struct OperatorPrecedence {
+    int level;
+    Associativity associativity;
+};
+
+class Algo {
+public:
+    using ProductionRulesType = std::map<char, std::vector<std::string>>;
+    using TerminalSetType = std::set<char>;
+    using NonTerminalSetType = std::map<char, NonTerminal>;
+    using AutomatonType = std::vector<State>;
+    using StateIndexType = std::unordered_map<std::string, int>;
+    using CoreClosureCacheType = std::unordered_map<std::string, CoreClosure>;
+    using KernelClosureCacheType = std::unordered_map<std::string, std::vector<Item>>;
+    using ProductionsType = std::vector<Production>;
+    using TableType = ParseTable;
+
+    ProductionRulesType production_rules;
+    ProductionsType productions;
+    std::map<char, std::vector<int>> productions_of;
+    std::map<char, OperatorPrecedence> precedence;
+    size_t core_count = 0;
+    std::vector<SymbolSet> first_of_suffix;
+    TerminalSetType terminals;
+    NonTerminalSetType nonterminals;
+    AutomatonType states;
+    StateIndexType state_index;
+    CoreClosureCacheType core_closures;
+    ConstructionStats construction_stats;
+    TableType table;
+    int accept_state_id = kNoState;
+    BuildOptions options;
+    std::shared_ptr<const MappedFile> table_file;
+    TableView table_file_view;
+    std::shared_ptr<const CompressedTable> compressed_table;
+    std::shared_ptr<const LazyTable> lazy_table;
+    explicit Algo(std::vector<std::string> &grammar, const BuildOptions &build_options = BuildOptions());
+    Algo(const std::string &table_path, std::vector<std::string> &grammar);
+    void Fit(std::vector<std::string> &grammar, const BuildOptions &build_options = BuildOptions());
+    void ProcessInputGrammar(std::vector<std::string> &grammar);
+    void DeclarePrecedence(const std::string &declaration);
+    void NumberProductions();
+    void CollectSymbols();
+    void CalculateFirstSets();
+    void UpdateFirstSets(const std::vector<int> &dirty_productions);
+    SymbolSet CalculateFirstOfChain(const std::string &chain);
+    int CoreId(const Item &item) const;
+    char SymbolAfterDot(const Item &item) const;
+    // kShift, kReduce, kError for a %nonassoc operator, or kConflict when no precedence decides.
+    ActionType ResolveShiftReduce(char lookahead, int production) const;
+    std::string ItemToString(const Item &item) const;
+    CoreClosure CalculateCoreClosure(const std::vector<Item> &kernel) const;
+    std::vector<Item> Closure(std::vector<Item> items, CoreClosureCacheType &cache, ConstructionStats &stats) const;
+    std::vector<Item> Closure(std::vector<Item> items);
+    std::vector<Item> Transition(State &state, char symbol);
+    std::vector<std::pair<char, std::vector<Item>>> SuccessorKernels(const std::vector<Item> &items) const;
+    int StateAlreadyExists(std::vector<Item> &curr_state);
+    int AddState(const std::vector<Item> &new_state);
+    void CalculateStates(const KernelClosureCacheType *reusable_closures = nullptr);
+    void CalculateStatesInParallel();
+    void MergeStates();
+    void MakeTable();
+    void BuildAutomaton(const KernelClosureCacheType *reusable_closures = nullptr);
+    // Grammar edits. The result equals a fresh Fit of the edited grammar, with an added rule numbered last.
+    // A grammar made invalid by the edit throws GrammarException and leaves the parser as it was.
+    void AddProduction(const std::string &rule);
+    void RemoveProduction(const std::string &rule);
+    void ApplyGrammarEdit(char lhs, const std::vector<int> &new_id, bool removed);
+    std::uint64_t GrammarHash() const;
+    TableView View() const;
+    std::shared_ptr<const CompiledParser> Compile() const;
+    void RenumberStates(const std::vector<int> &new_id);
+    bool Parse(std::string_view input, ParseContext &context) const;
+    bool Parse(std::string_view input, ParseContext &context, const ReduceCallback &on_reduce) const;
+    // The input must outlive the generator.
+    Generator<ReduceEvent> ReduceEvents(std::string_view input) const;
+    // The tree is complete only if the word is accepted.
+    bool Parse(std::string_view input, ParseContext &context, ParseTree &tree) const;
+    // Runs the GLR driver, so conflicting actions of a GLR table are followed in parallel.
+    bool Parse(std::string_view input, ParseForest &forest) const;
+    RecognizeResult Recognize(std::string_view input, ParseContext &context) const;
+    RecognizeResult Recognize(std::string_view input) const;
+    bool Predict(std::string input, std::vector<std::string> &derivation_rules);
+};
+
+std::string CalculateDerivation(const std::vector<std::string> &derivation_rules);
+std::string CalculateDerivation(const Algo &parser, const ParseTreeView &tree);
+void PrintStates(const Algo &parser);
+void PrintTable(const Algo &parser);
+void SaveTable(const Algo &parser, const std::string &path);
+// Throw std::logic_error for a lazily built parser and for a table with conflicting actions.
+void RequireCompleteTable(const Algo &parser);
+void RequireDeterministicTable(const Algo &parser);
+StateProfile ProfileStates(const Algo &parser, const std::vector<std::string> &corpus);
+std::vector<int> ProfileGuidedOrder(const StateProfile &profile);
+
+#endif //CLR1_PARSER_CLR1_PARSER_H
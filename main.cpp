@@ -7,9 +7,11 @@ int main() {
     std::cout << "(1) Enter the grammar rules line by line in the format \"S->AbCd\" without spaces.\n";
     std::cout << "(2) Terminal can be any character except uppercase English characters, '$', '.' and '@'.\n";
     std::cout << "(3) For an empty terminal, use '~'.\n";
-    std::cout << "(4) After all the rules, specify the starting nonterminal.\n";
-    std::cout << "(5) Enter the words to be checked line by line.\n";
-    std::cout << "(6) After finishing working with the parser, write \"[STOP]\".\n\n";
+    std::cout << "(4) Rules may be mixed with precedence lines \"%left+-\", \"%right^\" or \"%nonassoc<\";\n"
+                 "    later lines bind tighter.\n";
+    std::cout << "(5) After all the rules, specify the starting nonterminal.\n";
+    std::cout << "(6) Enter the words to be checked line by line.\n";
+    std::cout << "(7) After finishing working with the parser, write \"[STOP]\".\n\n";
     std::cout << "Write grammar rules:\n";
     std::string current_input;
     do {
@@ -23,12 +25,12 @@ int main() {
     std::cout << "Enter words:\n";
     std::string input;
     std::cin >> input;
+    ParseContext context;
     while (input != "[STOP]") {
-        std::vector<std::string> derivation_rules;
-        if (parser.Predict(input, derivation_rules)) {
+        if (parser.Parse(input, context)) {
             std::cout << input << " belongs to grammar" << '\n';
-            auto derivation = CalculateDerivation(derivation_rules);
-            std::cout << "Rightmost derivation: " << derivation << '\n';
+            DerivationView derivation(parser, context.reductions);
+            std::cout << "Rightmost derivation: " << derivation.ToString() << '\n';
         } else {
             std::cout << input << " doesn't belong to grammar" << '\n';
         }
@@ -0,0 +1,308 @@
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <random>
+#include "CLR1_parser.h"
+#include "brackets_table.h"
+#include "brackets_ascent.h"
+#include "arithmetic_table.h"
+#include "arithmetic_ascent.h"
+#include "power_table.h"
+#include "power_ascent.h"
+#include "pairs_table.h"
+#include "pairs_ascent.h"
+
+static std::vector<std::string> ReadGrammar(const std::string &name) {
+    std::ifstream file(std::string(GRAMMARS_DIR) + "/" + name + ".txt");
+    std::vector<std::string> grammar;
+    std::string line;
+    while (file >> line) {
+        grammar.push_back(line);
+    }
+    return grammar;
+}
+
+// Generates sentences of the grammar by random derivation. Once the depth budget is spent every nonterminal
+// is expanded by the production with the shortest terminal yield, so the derivation always terminates.
+class SentenceGenerator {
+public:
+    explicit SentenceGenerator(const Algo &parser) : parser_(parser) {
+        for (auto &nonterminal: parser_.nonterminals) {
+            shortest_yield_[nonterminal.first] = kUnknownYield;
+        }
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (auto &production: parser_.productions) {
+                auto yield = YieldOf(production.symbols);
+                if (yield < shortest_yield_[production.lhs]) {
+                    shortest_yield_[production.lhs] = yield;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::string Generate(std::mt19937 &generator, int depth) {
+        std::string sentence;
+        Expand(parser_.productions[0].symbols[0], generator, depth, sentence);
+        return sentence;
+    }
+
+private:
+    size_t YieldOf(const std::string &symbols) {
+        size_t yield = 0;
+        for (auto symbol: symbols) {
+            if (!parser_.nonterminals.contains(symbol)) {
+                ++yield;
+                continue;
+            }
+            auto shortest = shortest_yield_.at(symbol);
+            if (shortest == kUnknownYield) {
+                return kUnknownYield;
+            }
+            yield += shortest;
+        }
+        return yield;
+    }
+
+    void Expand(char symbol, std::mt19937 &generator, int depth, std::string &sentence) {
+        if (!parser_.nonterminals.contains(symbol)) {
+            sentence += symbol;
+            return;
+        }
+        auto &alternatives = parser_.productions_of.at(symbol);
+        auto chosen = alternatives[generator() % alternatives.size()];
+        if (depth <= 0) {
+            for (auto alternative: alternatives) {
+                if (YieldOf(parser_.productions[alternative].symbols) == shortest_yield_[symbol]) {
+                    chosen = alternative;
+                    break;
+                }
+            }
+        }
+        for (auto next: parser_.productions[chosen].symbols) {
+            Expand(next, generator, depth - 1, sentence);
+        }
+    }
+
+    static auto const kUnknownYield = std::numeric_limits<size_t>::max();
+
+    const Algo &parser_;
+    std::map<char, size_t> shortest_yield_;
+};
+
+static void PrintMeasurement(const std::string &name, double seconds, size_t bytes, size_t accepted) {
+    std::cout << "  " << std::left << std::setw(22) << name << std::right << std::setw(10) << std::fixed
+              << std::setprecision(3) << seconds << " s" << std::setw(12) << std::setprecision(1)
+              << static_cast<double>(bytes) / seconds / 1e6 << " MB/s  accepted " << accepted << '\n';
+}
+
+template<typename Parse>
+static void Measure(const std::string &name, const std::vector<std::string> &words, Parse parse) {
+    size_t bytes = 0;
+    size_t accepted = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto &word: words) {
+        accepted += parse(word);
+        bytes += word.size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    PrintMeasurement(name, elapsed.count(), bytes, accepted);
+}
+
+template<typename TableParse, typename AscentParse>
+static void BenchGrammar(const std::string &grammar_name, TableParse table_parse, AscentParse ascent_parse) {
+    auto grammar = ReadGrammar(grammar_name);
+    Algo parser(grammar);
+    SentenceGenerator sentences(parser);
+    std::mt19937 generator(2024);
+    std::vector<std::string> words;
+    for (int i = 0; i < 20000; ++i) {
+        words.push_back(sentences.Generate(generator, 12));
+    }
+    std::cout << grammar_name << ":\n";
+
+    Measure("Algo::Predict", words, [&parser](const std::string &word) {
+        std::vector<std::string> derivation_rules;
+        return parser.Predict(word, derivation_rules);
+    });
+    ParseContext context;
+    Measure("Algo::Parse", words, [&parser, &context](const std::string &word) {
+        return parser.Parse(word, context);
+    });
+    Measure("Algo::Recognize", words, [&parser, &context](const std::string &word) {
+        return parser.Recognize(word, context).accepted;
+    });
+    BuildOptions options;
+    options.compress_table = true;
+    Algo compressed(grammar, options);
+    Measure("compressed Recognize", words, [&compressed, &context](const std::string &word) {
+        return compressed.Recognize(word, context).accepted;
+    });
+    options = BuildOptions();
+    options.mode = ConstructionMode::kLazy;
+    Algo lazy(grammar, options);
+    Measure("lazy Recognize", words, [&lazy, &context](const std::string &word) {
+        return lazy.Recognize(word, context).accepted;
+    });
+    ParseForest forest;
+    Measure("GLR forest Parse", words, [&parser, &forest](const std::string &word) {
+        return parser.Parse(word, forest);
+    });
+    Measure("generated table", words, [table_parse](const std::string &word) {
+        std::vector<int> reductions;
+        return table_parse(word, &reductions);
+    });
+    Measure("generated ascent", words, [ascent_parse](const std::string &word) {
+        std::vector<int> reductions;
+        return ascent_parse(word, &reductions);
+    });
+    std::cout << "  table bytes: dense " << compressed.compressed_table->RawBytes() << ", compressed "
+              << compressed.compressed_table->Bytes() << '\n';
+    std::cout << "  lazy states built: " << lazy.lazy_table->BuiltRowCount() << " of " << parser.states.size()
+              << '\n';
+}
+
+// One shared CompiledParser, a growing number of ParseBatch workers.
+static void BenchBatch(const std::string &grammar_name) {
+    auto grammar = ReadGrammar(grammar_name);
+    Algo parser(grammar);
+    auto compiled = parser.Compile();
+    SentenceGenerator sentences(parser);
+    std::mt19937 generator(2024);
+    std::vector<std::string> words;
+    for (int i = 0; i < 200000; ++i) {
+        words.push_back(sentences.Generate(generator, 12));
+    }
+    std::cout << "ParseBatch, " << grammar_name << ":\n";
+    size_t bytes = 0;
+    for (auto &word: words) {
+        bytes += word.size();
+    }
+    auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        auto results = ParseBatch(*compiled, words, threads);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        auto accepted = std::count_if(results.begin(), results.end(), [](const RecognizeResult &result) {
+            return result.accepted;
+        });
+        PrintMeasurement(std::to_string(threads) + " threads", elapsed.count(), bytes, accepted);
+    }
+}
+
+// The stratified arithmetic grammar against E->E+E|E*E with %left declarations, on the same words.
+static void BenchPrecedence() {
+    std::cout << "Precedence declarations, arithmetic:\n";
+    auto stratified_grammar = ReadGrammar("arithmetic");
+    Algo stratified(stratified_grammar);
+    auto compact_grammar = ReadGrammar("arithmetic_precedence");
+    Algo compact(compact_grammar);
+    SentenceGenerator sentences(stratified);
+    std::mt19937 generator(2024);
+    std::vector<std::string> words;
+    for (int i = 0; i < 20000; ++i) {
+        words.push_back(sentences.Generate(generator, 12));
+    }
+    ParseContext context;
+    for (auto [name, parser]: {std::pair{"stratified", &stratified}, std::pair{"precedence", &compact}}) {
+        size_t reductions = 0;
+        Measure(std::string(name) + " Parse", words, [parser, &context, &reductions](const std::string &word) {
+            auto accepted = parser->Parse(word, context);
+            reductions += context.reductions.size();
+            return accepted;
+        });
+        std::cout << "  states " << parser->states.size() << ", reductions per word "
+                  << static_cast<double>(reductions) / static_cast<double>(words.size()) << '\n';
+    }
+}
+
+// Arithmetic with an ambiguous E->E-E added, parsed in GLR mode. Only every 20th word has a '-', so most of the
+// input runs on the deterministic path of the GLR driver.
+static void BenchGlr() {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo parser(grammar);
+    grammar.insert(grammar.end() - 1, "E->E-E");
+    BuildOptions options;
+    options.glr = true;
+    Algo ambiguous(grammar, options);
+    SentenceGenerator sentences(parser);
+    std::mt19937 generator(2024);
+    std::vector<std::string> words;
+    for (int i = 0; i < 20000; ++i) {
+        words.push_back(sentences.Generate(generator, 12));
+        if (i % 20 == 0) {
+            std::replace(words.back().begin(), words.back().end(), '+', '-');
+        }
+    }
+    std::cout << "GLR, arithmetic with E->E-E, " << ambiguous.table.conflicts.size() << " conflict cells:\n";
+    ParseContext context;
+    Measure("LR Recognize", words, [&parser, &context](const std::string &word) {
+        return parser.Recognize(word, context).accepted;
+    });
+    Measure("GLR Recognize", words, [&ambiguous, &context](const std::string &word) {
+        return ambiguous.Recognize(word, context).accepted;
+    });
+    ParseForest forest;
+    Measure("GLR forest Parse", words, [&ambiguous, &forest](const std::string &word) {
+        return ambiguous.Parse(word, forest);
+    });
+}
+
+// Single-character edits in the middle of a long expression: full Recognize against a ParseSession.
+static void BenchSession() {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo parser(grammar);
+    std::string text = "1";
+    for (int i = 0; i < 100000; ++i) {
+        text += "+2*(3+1)";
+    }
+    std::cout << "ParseSession, arithmetic, " << text.size() << " characters:\n";
+    std::mt19937 generator(2024);
+    std::vector<size_t> digits;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (std::isdigit(static_cast<unsigned char>(text[i]))) {
+            digits.push_back(i);
+        }
+    }
+    std::vector<size_t> offsets;
+    for (int i = 0; i < 50; ++i) {
+        offsets.push_back(digits[generator() % digits.size()]);
+    }
+
+    ParseContext context;
+    auto edited = text;
+    size_t accepted = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto offset: offsets) {
+        edited[offset] = edited[offset] == '1' ? '2' : '1';
+        accepted += parser.Recognize(edited, context).accepted;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    PrintMeasurement("Recognize per edit", elapsed.count(), offsets.size() * text.size(), accepted);
+
+    ParseSession session(parser);
+    session.Reset(text);
+    accepted = 0;
+    size_t scanned = 0;
+    start = std::chrono::steady_clock::now();
+    for (auto offset: offsets) {
+        accepted += session.Edit(offset, 1, session.Text()[offset] == '1' ? "2" : "1").accepted;
+        scanned += session.LastScanned();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    PrintMeasurement("ParseSession::Edit", elapsed.count(), offsets.size() * text.size(), accepted);
+    std::cout << "  characters rescanned per edit: " << scanned / offsets.size() << '\n';
+}
+
+int main() {
+    BenchGrammar("brackets", brackets_table::Parse, brackets_ascent::Parse);
+    BenchGrammar("arithmetic", arithmetic_table::Parse, arithmetic_ascent::Parse);
+    BenchGrammar("power", power_table::Parse, power_ascent::Parse);
+    BenchGrammar("pairs", pairs_table::Parse, pairs_ascent::Parse);
+    BenchPrecedence();
+    BenchGlr();
+    BenchBatch("arithmetic");
+    BenchSession();
+    return 0;
+}
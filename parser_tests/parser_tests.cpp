@@ -1,265 +1,1804 @@
-#include <gtest/gtest.h>
-#include "CLR1_parser.h"
-
-TEST(Predict, CorrectBracketSequences) {
-    std::vector<std::string> grammar = {"S->(S)S",
-                                        "S->[S]S",
-                                        "S->{S}S",
-                                        "S->~", // '~' stands for epsilon
-                                        "S"};
-    Algo parser(grammar);
-
-    // Input: (()())
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("(()())", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->S->(S)S->(S)->((S)S)->((S)(S)S)->((S)(S))->((S)())->(()())");
-    }
-
-    // Input: ())
-    {
-        std::vector<std::string> derivation_rules;
-        ASSERT_EQ(parser.Predict("())", derivation_rules), false);
-    }
-
-    // Input: [({})]
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("[({})]", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->S->[S]S->[S]->[(S)S]->[(S)]->[({S}S)]->[({S})]->[({})]");
-    }
-
-    // Input: ([)]
-    {
-        std::vector<std::string> derivation_rules;
-        ASSERT_EQ(parser.Predict("([)]", derivation_rules), false);
-    }
-
-    // Input: [{}()]
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("[{}()]", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->S->[S]S->[S]->[{S}S]->[{S}(S)S]->[{S}(S)]->[{S}()]->[{}()]");
-    }
-
-}
-
-TEST(Predict, ArithmeticExpressions) {
-    std::vector<std::string> grammar = {"E->E+T",
-                                        "E->T",
-                                        "T->T*F",
-                                        "T->F",
-                                        "F->(E)",
-                                        "F->1",
-                                        "F->2",
-                                        "F->3",
-                                        "E"};
-
-    Algo parser(grammar);
-
-    // Input: (1+1)*2
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("(1+1)*2", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->E->T->T*F->T*2->F*2->(E)*2->(E+T)*2->(E+F)*2->(E+1)*2->(T+1)*2->(F+1)*2->(1+1)*2");
-    }
-
-    // Input: 1++
-    {
-        std::vector<std::string> derivation_rules;
-        ASSERT_EQ(parser.Predict("1++", derivation_rules), false);
-    }
-
-    // Input: (1*2*3)
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("(1*2*3)", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->E->T->F->(E)->(T)->(T*F)->(T*3)->(T*F*3)->(T*2*3)->(F*2*3)->(1*2*3)");
-    }
-
-}
-
-TEST(Predict, EmptyString) {
-    std::vector<std::string> grammar = {"S->AB",
-                                        "A->CD",
-                                        "C->d",
-                                        "C->~",
-                                        "D->~",
-                                        "B->a",
-                                        "B->~",
-                                        "S"};
-
-    Algo parser(grammar);
-
-    // Input: ~
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("~", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->S->AB->A->CD->C->");
-    }
-
-    grammar = {"S->~", "S"};
-    parser = Algo(grammar);
-
-    // Input: ~
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("~", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->S->");
-    }
-
-}
-
-TEST(Predict, ArbitaryGrammars) {
-    std::vector<std::string> grammar = {"S->CC",
-                                        "C->cC",
-                                        "C->d",
-                                        "S"};
-
-    Algo parser(grammar);
-
-    // Input: ccccdd
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("ccccdd", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->S->CC->Cd->cCd->ccCd->cccCd->ccccCd->ccccdd");
-    }
-
-    // Input: cccc
-    {
-        std::vector<std::string> derivation_rules;
-        ASSERT_EQ(parser.Predict("cccc", derivation_rules), false);
-    }
-
-    grammar = {"S->S+A",
-               "S->~",
-               "A->A*B",
-               "A->B",
-               "B->C^B",
-               "B->C",
-               "C->a",
-               "S"};
-
-    parser = Algo(grammar);
-
-    // Input: +a^a*a
-    {
-        std::vector<std::string> derivation_rules;
-        std::string derivation;
-        ASSERT_EQ(parser.Predict("+a^a*a", derivation_rules), true);
-        derivation = CalculateDerivation(derivation_rules);
-        ASSERT_EQ(derivation, "@->S->S+A->S+A*B->S+A*C->S+A*a->S+B*a->S+C^B*a->S+C^C*a->S+C^a*a->S+a^a*a->+a^a*a");
-    }
-
-    // Input: ^a+
-    {
-        std::vector<std::string> derivation_rules;
-        ASSERT_EQ(parser.Predict("^a+", derivation_rules), false);
-    }
-
-}
-
-TEST(Exceptions, ShiftReduceConflict) {
-
-    std::vector<std::string> grammar = {"S->E",
-                                        "E->T",
-                                        "E->(E)",
-                                        "T->n",
-                                        "T->+T",
-                                        "T->T+n",
-                                        "S"};
-    try {
-        Algo parser(grammar);
-    } catch (std::runtime_error &error) {
-        ASSERT_EQ(std::string(error.what()), "Shift/Reduce conflict occurred. The grammar is no LR(1) type.");
-    }
-
-    grammar = {"S->RS",
-               "S->R",
-               "R->abT",
-               "T->aT",
-               "T->c",
-               "T->~",
-               "S"};
-    try {
-        Algo parser(grammar);
-    } catch (std::runtime_error &error) {
-        ASSERT_EQ(std::string(error.what()), "Shift/Reduce conflict occurred. The grammar is no LR(1) type.");
-    }
-
-}
-
-
-TEST(Exceptions, ReduceReduceConflict) {
-    std::vector<std::string> grammar = {"S->AB",
-                                        "A->~",
-                                        "B->c",
-                                        "B->d",
-                                        "B->D",
-                                        "D->n",
-                                        "D->BA",
-                                        "S"};
-    try {
-        Algo parser(grammar);
-    } catch (std::runtime_error &error) {
-        ASSERT_EQ(std::string(error.what()), "Reduce/Reduce conflict occurred. The grammar is no LR(1) type.");
-    }
-
-    grammar = {"S->X",
-               "X->Y",
-               "X->1",
-               "Y->1"
-               "S"};
-
-    try {
-        Algo parser(grammar);
-    } catch (std::runtime_error &error) {
-        ASSERT_EQ(std::string(error.what()), "Reduce/Reduce conflict occurred. The grammar is no LR(1) type.");
-    }
-}
-
-TEST(Exceptions, UselessCharacters) {
-    std::vector<std::string> grammar = {"S->S+A",
-                                        "A->A*B",
-                                        "A->B",
-                                        "B->C^B",
-                                        "B->C",
-                                        "C->a",
-                                        "S"};
-    try {
-        Algo parser(grammar);
-    } catch (std::runtime_error &error) {
-        ASSERT_EQ(std::string(error.what()), "The grammar contains useless characters.");
-    }
-}
-
-TEST(Exceptions, RulesAbsence) {
-    std::vector<std::string> grammar = {"S"};
-    try {
-        Algo parser(grammar);
-    } catch (std::runtime_error &error) {
-        ASSERT_EQ(std::string(error.what()), "The grammar is incorrect. There are no reachable symbols.");
-    }
-}
-
-
-int main(int argc, char **argv) {
-    ::testing::InitGoogleTest(&argc, argv);
-    return RUN_ALL_TESTS();
-}
+#include <gtest/gtest.h>
+#include <atomic>
+#include <fstream>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <random>
+#include "CLR1_parser.h"
+#include "CLR1_constexpr.h"
+#include "brackets_table.h"
+#include "brackets_ascent.h"
+#include "arithmetic_table.h"
+#include "arithmetic_ascent.h"
+#include "power_table.h"
+#include "power_ascent.h"
+#include "pairs_table.h"
+#include "pairs_ascent.h"
+
+// Counts heap allocations of the whole test binary to check the allocation-free parsing paths. Every form of
+// the global operators is replaced, so each allocation is released by the matching free.
+static std::atomic<size_t> allocations_count = 0;
+
+static void *CountedAllocation(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    ++allocations_count;
+    size = std::max<size_t>(size, 1);
+    auto memory = alignment <= alignof(std::max_align_t)
+                  ? std::malloc(size)
+                  : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new(size_t size) {
+    return CountedAllocation(size);
+}
+
+void *operator new[](size_t size) {
+    return CountedAllocation(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    return CountedAllocation(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return CountedAllocation(size, static_cast<size_t>(alignment));
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return CountedAllocation(size);
+    } catch (std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return CountedAllocation(size);
+    } catch (std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    try {
+        return CountedAllocation(size, static_cast<size_t>(alignment));
+    } catch (std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    try {
+        return CountedAllocation(size, static_cast<size_t>(alignment));
+    } catch (std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+static std::vector<std::string> ReadGrammar(const std::string &name) {
+    std::ifstream file(std::string(GRAMMARS_DIR) + "/" + name + ".txt");
+    std::vector<std::string> grammar;
+    std::string line;
+    while (file >> line) {
+        grammar.push_back(line);
+    }
+    return grammar;
+}
+
+// Checks the generated parser against Algo::Predict on every word over the alphabet up to the given length.
+template<typename Parse, size_t RulesNumber>
+static void ExpectSameAsPredict(const std::string &grammar_name, const std::string &alphabet, size_t max_length,
+                                Parse parse, const std::string_view (&rules)[RulesNumber]) {
+    auto grammar = ReadGrammar(grammar_name);
+    Algo parser(grammar);
+    std::vector<std::string> words = {"~"};
+    for (size_t begin = 0, length = 1; length <= max_length; ++length) {
+        auto end = words.size();
+        for (auto i = begin; i < end; ++i) {
+            for (auto symbol: alphabet) {
+                words.push_back(words[i] == "~" ? std::string{symbol} : words[i] + symbol);
+            }
+        }
+        begin = end;
+    }
+    for (auto &word: words) {
+        std::vector<std::string> derivation_rules;
+        std::vector<int> reductions;
+        auto expected = parser.Predict(word, derivation_rules);
+        ASSERT_EQ(parse(word, &reductions), expected) << word;
+        if (expected) {
+            std::vector<std::string> generated_rules;
+            for (auto production: reductions) {
+                generated_rules.emplace_back(rules[production]);
+            }
+            ASSERT_EQ(generated_rules, derivation_rules) << word;
+        }
+    }
+}
+
+TEST(Predict, CorrectBracketSequences) {
+    std::vector<std::string> grammar = {"S->(S)S",
+                                        "S->[S]S",
+                                        "S->{S}S",
+                                        "S->~", // '~' stands for epsilon
+                                        "S"};
+    Algo parser(grammar);
+
+    // Input: (()())
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("(()())", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->S->(S)S->(S)->((S)S)->((S)(S)S)->((S)(S))->((S)())->(()())");
+    }
+
+    // Input: ())
+    {
+        std::vector<std::string> derivation_rules;
+        ASSERT_EQ(parser.Predict("())", derivation_rules), false);
+    }
+
+    // Input: [({})]
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("[({})]", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->S->[S]S->[S]->[(S)S]->[(S)]->[({S}S)]->[({S})]->[({})]");
+    }
+
+    // Input: ([)]
+    {
+        std::vector<std::string> derivation_rules;
+        ASSERT_EQ(parser.Predict("([)]", derivation_rules), false);
+    }
+
+    // Input: [{}()]
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("[{}()]", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->S->[S]S->[S]->[{S}S]->[{S}(S)S]->[{S}(S)]->[{S}()]->[{}()]");
+    }
+
+}
+
+TEST(Predict, ArithmeticExpressions) {
+    std::vector<std::string> grammar = {"E->E+T",
+                                        "E->T",
+                                        "T->T*F",
+                                        "T->F",
+                                        "F->(E)",
+                                        "F->1",
+                                        "F->2",
+                                        "F->3",
+                                        "E"};
+
+    Algo parser(grammar);
+
+    // Input: (1+1)*2
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("(1+1)*2", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->E->T->T*F->T*2->F*2->(E)*2->(E+T)*2->(E+F)*2->(E+1)*2->(T+1)*2->(F+1)*2->(1+1)*2");
+    }
+
+    // Input: 1++
+    {
+        std::vector<std::string> derivation_rules;
+        ASSERT_EQ(parser.Predict("1++", derivation_rules), false);
+    }
+
+    // Input: (1*2*3)
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("(1*2*3)", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->E->T->F->(E)->(T)->(T*F)->(T*3)->(T*F*3)->(T*2*3)->(F*2*3)->(1*2*3)");
+    }
+
+}
+
+TEST(Predict, EmptyString) {
+    std::vector<std::string> grammar = {"S->AB",
+                                        "A->CD",
+                                        "C->d",
+                                        "C->~",
+                                        "D->~",
+                                        "B->a",
+                                        "B->~",
+                                        "S"};
+
+    Algo parser(grammar);
+
+    // Input: ~
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("~", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->S->AB->A->CD->C->");
+    }
+
+    grammar = {"S->~", "S"};
+    parser = Algo(grammar);
+
+    // Input: ~
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("~", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->S->");
+    }
+
+}
+
+TEST(Predict, ArbitaryGrammars) {
+    std::vector<std::string> grammar = {"S->CC",
+                                        "C->cC",
+                                        "C->d",
+                                        "S"};
+
+    Algo parser(grammar);
+
+    // Input: ccccdd
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("ccccdd", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->S->CC->Cd->cCd->ccCd->cccCd->ccccCd->ccccdd");
+    }
+
+    // Input: cccc
+    {
+        std::vector<std::string> derivation_rules;
+        ASSERT_EQ(parser.Predict("cccc", derivation_rules), false);
+    }
+
+    grammar = {"S->S+A",
+               "S->~",
+               "A->A*B",
+               "A->B",
+               "B->C^B",
+               "B->C",
+               "C->a",
+               "S"};
+
+    parser = Algo(grammar);
+
+    // Input: +a^a*a
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("+a^a*a", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->S->S+A->S+A*B->S+A*C->S+A*a->S+B*a->S+C^B*a->S+C^C*a->S+C^a*a->S+a^a*a->+a^a*a");
+    }
+
+    // Input: ^a+
+    {
+        std::vector<std::string> derivation_rules;
+        ASSERT_EQ(parser.Predict("^a+", derivation_rules), false);
+    }
+
+}
+
+TEST(Predict, LookaheadsMergedInClosure) {
+    std::vector<std::string> grammar = {"S->Ac",
+                                        "S->Bd",
+                                        "B->A",
+                                        "A->C",
+                                        "C->x",
+                                        "S"};
+
+    Algo parser(grammar);
+
+    // Input: xd
+    {
+        std::vector<std::string> derivation_rules;
+        std::string derivation;
+        ASSERT_EQ(parser.Predict("xd", derivation_rules), true);
+        derivation = CalculateDerivation(derivation_rules);
+        ASSERT_EQ(derivation, "@->S->Bd->Ad->Cd->xd");
+    }
+
+    // Input: xc
+    {
+        std::vector<std::string> derivation_rules;
+        ASSERT_EQ(parser.Predict("xc", derivation_rules), true);
+    }
+
+    // Input: x
+    {
+        std::vector<std::string> derivation_rules;
+        ASSERT_EQ(parser.Predict("x", derivation_rules), false);
+    }
+}
+
+TEST(SymbolSet, BitOperations) {
+    SymbolSet first{'b', '$'};
+    SymbolSet second{'a', 'b', static_cast<char>(200)};
+
+    ASSERT_TRUE(first.contains('$'));
+    ASSERT_FALSE(first.contains('a'));
+    ASSERT_TRUE(first.Merge(second));
+    ASSERT_FALSE(first.Merge(second));
+    ASSERT_EQ(first.size(), 4);
+
+    std::string symbols(first.begin(), first.end());
+    ASSERT_EQ(symbols, std::string("$ab") + static_cast<char>(200));
+
+    first.erase('$');
+    first.erase(static_cast<char>(200));
+    ASSERT_EQ(first, (SymbolSet{'a', 'b'}));
+    ASSERT_EQ(first.Hash(), (SymbolSet{'b', 'a'}).Hash());
+    ASSERT_TRUE(SymbolSet().empty());
+}
+
+TEST(First, FixedPointWithNullableSymbols) {
+    std::vector<std::string> grammar = {"S->AB",
+                                        "A->CD",
+                                        "C->d",
+                                        "C->~",
+                                        "D->~",
+                                        "B->a",
+                                        "B->~",
+                                        "S"};
+
+    Algo parser(grammar);
+
+    ASSERT_EQ(parser.nonterminals['S'].first, (SymbolSet{'a', 'd', kEpsilon}));
+    ASSERT_EQ(parser.nonterminals['A'].first, (SymbolSet{'d', kEpsilon}));
+    ASSERT_EQ(parser.nonterminals['D'].first, (SymbolSet{kEpsilon}));
+    ASSERT_EQ(parser.CalculateFirstOfChain("Ba"), (SymbolSet{'a'}));
+
+    auto &production = parser.productions[1];
+    ASSERT_EQ(production.rule, "S->AB");
+    ASSERT_EQ(parser.first_of_suffix[production.core_offset + 1], (SymbolSet{'a', kEpsilon}));
+    ASSERT_EQ(parser.first_of_suffix[production.core_offset + 2], (SymbolSet{kEpsilon}));
+}
+
+TEST(Table, DenseActionAndGotoCells) {
+    std::vector<std::string> grammar = {"S->CC",
+                                        "C->cC",
+                                        "C->d",
+                                        "S"};
+
+    Algo parser(grammar);
+
+    ASSERT_EQ(parser.table.state_count, parser.states.size());
+    ASSERT_EQ(parser.table.terminal_count, 3);
+    ASSERT_EQ(parser.table.nonterminal_count, 2);
+    ASSERT_EQ(parser.table.Column('a'), kNoColumn);
+
+    auto after_c = parser.table.Action(0, parser.table.Column('c'));
+    ASSERT_EQ(ParseTable::TypeOf(after_c), ActionType::kShift);
+
+    auto accept_state = parser.table.Goto(0, parser.table.Column('S'));
+    ASSERT_NE(accept_state, kNoState);
+    auto accept = parser.table.Action(accept_state, parser.table.Column(kEndOfLine));
+    ASSERT_EQ(ParseTable::TypeOf(accept), ActionType::kAccept);
+
+    auto after_d = ParseTable::ValueOf(parser.table.Action(0, parser.table.Column('d')));
+    auto reduce = parser.table.Action(after_d, parser.table.Column('c'));
+    ASSERT_EQ(ParseTable::TypeOf(reduce), ActionType::kReduce);
+    ASSERT_EQ(parser.productions[ParseTable::ValueOf(reduce)].rule, "C->d");
+}
+
+TEST(Automaton, StateIndexMatchesStates) {
+    std::vector<std::string> grammar = {"E->E+T",
+                                        "E->T",
+                                        "T->T*F",
+                                        "T->F",
+                                        "F->(E)",
+                                        "F->1",
+                                        "E"};
+
+    Algo parser(grammar);
+
+    ASSERT_EQ(parser.state_index.size(), parser.states.size());
+    for (auto &state: parser.states) {
+        auto items = state.items;
+        ASSERT_EQ(parser.StateAlreadyExists(items), state.personal_id);
+    }
+}
+
+TEST(Automaton, KernelAndCoreClosureCaches) {
+    std::vector<std::string> grammar = {"S->CC",
+                                        "C->cC",
+                                        "C->d",
+                                        "S"};
+
+    Algo parser(grammar);
+    auto &stats = parser.construction_stats;
+
+    size_t transitions = 0;
+    for (auto &state: parser.states) {
+        transitions += state.transitions.size();
+    }
+    ASSERT_EQ(stats.kernel_misses, parser.states.size() - 1);
+    ASSERT_EQ(stats.kernel_hits + stats.kernel_misses, transitions);
+    ASSERT_EQ(stats.core_closure_hits + stats.core_closure_misses, parser.states.size());
+    // States reached by c, d and C differ only in lookaheads after the first C.
+    ASSERT_EQ(stats.core_closure_hits, 3);
+}
+
+TEST(Automaton, ParallelConstructionMatchesSequential) {
+    std::vector<std::string> grammar = {"E->E+T",
+                                        "E->E-T",
+                                        "E->T",
+                                        "T->T*F",
+                                        "T->T/F",
+                                        "T->F",
+                                        "F->P^F",
+                                        "F->P",
+                                        "P->(E)",
+                                        "P->-P",
+                                        "P->1",
+                                        "P->2",
+                                        "E"};
+
+    Algo sequential(grammar);
+    for (unsigned threads: {2, 4, 8}) {
+        Algo parallel(grammar, BuildOptions{threads});
+        ASSERT_EQ(parallel.states.size(), sequential.states.size());
+        ASSERT_EQ(parallel.accept_state_id, sequential.accept_state_id);
+        ASSERT_EQ(parallel.table.actions, sequential.table.actions);
+        ASSERT_EQ(parallel.table.gotos, sequential.table.gotos);
+        ASSERT_EQ(parallel.construction_stats.kernel_misses, sequential.construction_stats.kernel_misses);
+        for (size_t i = 0; i < sequential.states.size(); ++i) {
+            ASSERT_EQ(parallel.states[i].personal_id, static_cast<int>(i));
+            ASSERT_EQ(parallel.states[i].items, sequential.states[i].items);
+        }
+
+        std::vector<std::string> derivation_rules;
+        ASSERT_EQ(parallel.Predict("-(1+2)*2^1/2", derivation_rules), true);
+    }
+}
+
+TEST(Automaton, MinimalModeMergesCompatibleStates) {
+    std::vector<std::string> grammar = {"S->CC",
+                                        "C->cC",
+                                        "C->d",
+                                        "S"};
+
+    Algo parser(grammar, BuildOptions{1, ConstructionMode::kMinimal});
+    ASSERT_EQ(parser.construction_stats.canonical_states, 10);
+    ASSERT_EQ(parser.construction_stats.merged_states, 7);
+    ASSERT_EQ(parser.states.size(), 7);
+
+    std::vector<std::string> derivation_rules;
+    ASSERT_EQ(parser.Predict("ccccdd", derivation_rules), true);
+    ASSERT_EQ(CalculateDerivation(derivation_rules), "@->S->CC->Cd->cCd->ccCd->cccCd->ccccCd->ccccdd");
+    ASSERT_EQ(parser.Predict("cccc", derivation_rules), false);
+    ASSERT_EQ(parser.Predict("dcd", derivation_rules), true);
+}
+
+TEST(Automaton, MinimalModeKeepsConflictingStatesApart) {
+    // LR(1), but merging the states after 'ae' and 'be' gives a reduce/reduce conflict (not LALR(1)).
+    // The states after 'dg' and 'fg' only differ in lookaheads and merge without one.
+    std::vector<std::string> grammar = {"S->aEa",
+                                        "S->bEb",
+                                        "S->aFb",
+                                        "S->bFa",
+                                        "E->e",
+                                        "F->e",
+                                        "S->dGa",
+                                        "S->fGb",
+                                        "G->g",
+                                        "S"};
+
+    Algo canonical(grammar);
+    Algo minimal(grammar, BuildOptions{1, ConstructionMode::kMinimal});
+    ASSERT_EQ(canonical.states.size(), 22u);
+    ASSERT_EQ(minimal.construction_stats.canonical_states, canonical.states.size());
+    ASSERT_EQ(minimal.states.size(), 21u);
+    ASSERT_EQ(minimal.construction_stats.merged_states, 21u);
+
+    // Lookaheads of every state whose items are exactly the completed items `rules`, in the order of the items.
+    auto lookaheads_of = [&minimal](const std::vector<std::string> &rules) {
+        std::vector<std::vector<SymbolSet>> found;
+        for (auto &state: minimal.states) {
+            std::vector<std::string> items;
+            std::vector<SymbolSet> lookaheads;
+            for (auto &item: state.items) {
+                items.push_back(minimal.ItemToString(item));
+                lookaheads.push_back(item.lookaheads);
+            }
+            if (items == rules) {
+                found.push_back(lookaheads);
+            }
+        }
+        return found;
+    };
+    auto split = lookaheads_of({"E->e.", "F->e."});
+    ASSERT_EQ(split.size(), 2u);
+    EXPECT_EQ(split[0], (std::vector<SymbolSet>{SymbolSet{'a'}, SymbolSet{'b'}}));
+    EXPECT_EQ(split[1], (std::vector<SymbolSet>{SymbolSet{'b'}, SymbolSet{'a'}}));
+    auto merged = lookaheads_of({"G->g."});
+    ASSERT_EQ(merged.size(), 1u);
+    EXPECT_EQ(merged[0], (std::vector<SymbolSet>{SymbolSet{'a', 'b'}}));
+
+    for (std::string word: {"aea", "beb", "aeb", "bea", "dga", "fgb"}) {
+        std::vector<std::string> canonical_rules;
+        std::vector<std::string> minimal_rules;
+        ASSERT_EQ(minimal.Predict(word, minimal_rules), true);
+        ASSERT_EQ(canonical.Predict(word, canonical_rules), true);
+        ASSERT_EQ(minimal_rules, canonical_rules);
+    }
+    for (std::string word: {"aee", "dgb", "fga"}) {
+        std::vector<std::string> derivation_rules;
+        EXPECT_EQ(minimal.Predict(word, derivation_rules), false) << word;
+    }
+}
+
+TEST(TableFile, CorruptedCellsAreRejected) {
+    auto grammar = ReadGrammar("arithmetic");
+    auto path = testing::TempDir() + "corrupted.clr1";
+    Algo built(grammar);
+    SaveTable(built, path);
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    TableFileHeader header{};
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    auto &table = built.table;
+    auto find_action = [&table](ActionType type) {
+        return static_cast<std::uint64_t>(std::find_if(table.actions.begin(), table.actions.end(), [type](auto cell) {
+            return ParseTable::TypeOf(cell) == type;
+        }) - table.actions.begin());
+    };
+    auto goto_cell = static_cast<std::uint64_t>(std::find_if(table.gotos.begin(), table.gotos.end(), [](int target) {
+        return target != kNoState;
+    }) - table.gotos.begin());
+    auto shift_cell = header.actions_offset + 4 * find_action(ActionType::kShift);
+    auto reduce_cell = header.actions_offset + 4 * find_action(ActionType::kReduce);
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> corruptions = {
+            {shift_cell, ParseTable::MakeAction(ActionType::kShift, static_cast<int>(table.state_count))},
+            {reduce_cell, ParseTable::MakeAction(ActionType::kReduce, static_cast<int>(built.productions.size()))},
+            {reduce_cell, ParseTable::MakeAction(ActionType::kReduce, 0)},
+            {reduce_cell, ParseTable::MakeAction(ActionType::kConflict)},
+            {reduce_cell, 7},
+            {header.gotos_offset + 4 * goto_cell, static_cast<std::uint32_t>(table.state_count)},
+            {header.lengths_offset + 4, table.production_lengths[1] + 1},
+            {header.lhs_offset + 4, static_cast<std::uint32_t>(table.nonterminal_count)},
+            {header.columns_offset + 4 * '1', static_cast<std::uint32_t>(table.terminal_count)}};
+    for (auto [offset, value]: corruptions) {
+        auto corrupted = bytes;
+        std::memcpy(corrupted.data() + offset, &value, sizeof(value));
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << corrupted;
+        EXPECT_THROW(Algo(path, grammar), TableFileException) << "offset " << offset;
+    }
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    EXPECT_TRUE(Algo(path, grammar).Recognize("(1+2)*3").accepted);
+    std::remove(path.c_str());
+}
+
+TEST(TableFile, SaveAndMap) {
+    std::vector<std::string> grammar = {"E->E+T",
+                                        "E->T",
+                                        "T->T*F",
+                                        "T->F",
+                                        "F->(E)",
+                                        "F->1",
+                                        "F->2",
+                                        "F->3",
+                                        "E"};
+    auto path = testing::TempDir() + "arithmetic.clr1";
+
+    Algo built(grammar);
+    SaveTable(built, path);
+    Algo mapped(path, grammar);
+
+    ASSERT_NE(mapped.table_file, nullptr);
+    ASSERT_TRUE(mapped.states.empty());
+    ASSERT_EQ(mapped.accept_state_id, built.accept_state_id);
+    auto view = mapped.View();
+    ASSERT_EQ(view.state_count, built.table.state_count);
+    ASSERT_TRUE(std::equal(built.table.actions.begin(), built.table.actions.end(), view.actions));
+    ASSERT_TRUE(std::equal(built.table.gotos.begin(), built.table.gotos.end(), view.gotos));
+
+    for (std::string word: {"(1+1)*2", "1++", "(1*2*3)", "3"}) {
+        std::vector<std::string> built_rules;
+        std::vector<std::string> mapped_rules;
+        ASSERT_EQ(mapped.Predict(word, mapped_rules), built.Predict(word, built_rules));
+        ASSERT_EQ(mapped_rules, built_rules);
+    }
+
+    std::vector<std::string> other_grammar = {"E->E+T",
+                                              "E->T",
+                                              "T->1",
+                                              "E"};
+    ASSERT_THROW(Algo(path, other_grammar), GrammarException);
+    ASSERT_THROW(Algo(path + ".missing", grammar), TableFileException);
+    EXPECT_THROW(mapped.RenumberStates({0}), std::logic_error);
+    std::remove(path.c_str());
+}
+
+TEST(Codegen, TableBackendMatchesPredict) {
+    ExpectSameAsPredict("brackets", "()[]{}", 6, brackets_table::Parse, brackets_table::kRules);
+    ExpectSameAsPredict("arithmetic", "+*()123", 5, arithmetic_table::Parse, arithmetic_table::kRules);
+    ExpectSameAsPredict("power", "+*^a", 6, power_table::Parse, power_table::kRules);
+    ExpectSameAsPredict("pairs", "cd", 8, pairs_table::Parse, pairs_table::kRules);
+}
+
+TEST(Codegen, RecursiveAscentBackendMatchesPredict) {
+    ExpectSameAsPredict("brackets", "()[]{}", 6, brackets_ascent::Parse, brackets_ascent::kRules);
+    ExpectSameAsPredict("arithmetic", "+*()123", 5, arithmetic_ascent::Parse, arithmetic_ascent::kRules);
+    ExpectSameAsPredict("power", "+*^a", 6, power_ascent::Parse, power_ascent::kRules);
+    ExpectSameAsPredict("pairs", "cd", 8, pairs_ascent::Parse, pairs_ascent::kRules);
+}
+
+static constexpr std::string_view kConstexprArithmetic[] = {"E->E+T", "E->T", "T->T*F", "T->F", "F->(E)", "F->x", "E"};
+static constexpr auto kConstexprArithmeticParser = CompileGrammar<kConstexprArithmetic>();
+static constexpr std::string_view kConstexprPairs[] = {"S->CC", "C->cC", "C->d", "S"};
+static constexpr auto kConstexprPairsParser = CompileGrammar<kConstexprPairs>();
+
+static_assert(kConstexprArithmeticParser.Parse("(x+x)*x"));
+static_assert(!kConstexprArithmeticParser.Parse("(x+x*x"));
+static_assert(kConstexprPairsParser.Parse("ccdd"));
+static_assert(!kConstexprPairsParser.Parse("cdc"));
+static_assert([] {
+    std::array<int, 8> stack{};
+    return kConstexprArithmeticParser.Parse("((x))*x", stack);
+}());
+
+template<typename Parser>
+static void ExpectSameTable(const Parser &static_parser, std::vector<std::string> grammar) {
+    Algo parser(grammar);
+    auto expected = parser.View();
+    auto actual = static_parser.View();
+    ASSERT_EQ(actual.state_count, expected.state_count);
+    ASSERT_EQ(actual.terminal_count, expected.terminal_count);
+    ASSERT_EQ(actual.nonterminal_count, expected.nonterminal_count);
+    EXPECT_EQ(static_parser.accept_state_id, parser.accept_state_id);
+    EXPECT_TRUE(std::equal(actual.column, actual.column + 256, expected.column));
+    EXPECT_TRUE(std::equal(actual.actions, actual.actions + actual.state_count * actual.terminal_count,
+                           expected.actions));
+    EXPECT_TRUE(std::equal(actual.gotos, actual.gotos + actual.state_count * actual.nonterminal_count,
+                           expected.gotos));
+    EXPECT_TRUE(std::equal(actual.production_lengths, actual.production_lengths + parser.productions.size(),
+                           expected.production_lengths));
+    EXPECT_TRUE(std::equal(actual.production_lhs, actual.production_lhs + parser.productions.size(),
+                           expected.production_lhs));
+}
+
+TEST(Constexpr, TableMatchesAlgo) {
+    ExpectSameTable(kConstexprArithmeticParser, {"E->E+T", "E->T", "T->T*F", "T->F", "F->(E)", "F->x", "E"});
+    ExpectSameTable(kConstexprPairsParser, {"S->CC", "C->cC", "C->d", "S"});
+}
+
+TEST(Constexpr, StackDepthIsBounded) {
+    std::array<int, 4> stack{};
+    std::vector<int> reductions;
+    EXPECT_TRUE(kConstexprArithmeticParser.Parse("x*x+x", stack, &reductions));
+    EXPECT_EQ(reductions.size(), 9u);
+    EXPECT_THROW(kConstexprArithmeticParser.Parse("((x))", stack), std::length_error);
+
+    auto nesting = kConstexprArithmeticParser.kDefaultStackDepth;
+    auto deep = std::string(nesting, '(') + "x" + std::string(nesting, ')');
+    EXPECT_THROW(kConstexprArithmeticParser.Parse(deep), std::length_error);
+    std::vector<int> large_stack(3 * nesting + 4);
+    EXPECT_TRUE(kConstexprArithmeticParser.Parse(deep, large_stack));
+}
+
+TEST(Constexpr, RuntimeErrors) {
+    std::string_view conflict[] = {"S->SaS", "S->b", "S"};
+    std::string_view useless[] = {"S->aA", "A->A", "S"};
+    std::string_view incorrect_lhs[] = {"s->a", "S"};
+    EXPECT_THROW(ConstexprAlgo{conflict}, GrammarException);
+    EXPECT_THROW(ConstexprAlgo{useless}, GrammarException);
+    EXPECT_THROW(ConstexprAlgo{incorrect_lhs}, GrammarException);
+}
+
+TEST(Parse, ReusedContextDoesNotAllocate) {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo parser(grammar);
+    std::vector<std::string> words = {"1+2*3", "(1+2)*3", "((((1))))+((2*3))", "1+", "(1*2", "~", "1$2", "(1)(2)"};
+    ParseContext context;
+    for (auto &word: words) {
+        std::vector<std::string> derivation_rules;
+        auto expected = parser.Predict(word, derivation_rules);
+        ASSERT_EQ(parser.Parse(word, context), expected) << word;
+        std::vector<std::string> rules;
+        for (auto production: context.reductions) {
+            rules.push_back(parser.productions[production].rule);
+        }
+        EXPECT_EQ(rules, derivation_rules) << word;
+    }
+    auto allocations_before = allocations_count.load();
+    size_t accepted = 0;
+    for (int repeat = 0; repeat < 100; ++repeat) {
+        for (auto &word: words) {
+            accepted += parser.Parse(word, context);
+        }
+    }
+    EXPECT_EQ(allocations_count.load(), allocations_before);
+    EXPECT_EQ(accepted, 300);
+}
+
+TEST(Recognize, ErrorOffsets) {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo parser(grammar);
+    ParseContext context;
+    auto expect_result = [&](std::string_view word, bool accepted, size_t error_offset) {
+        auto result = parser.Recognize(word, context);
+        EXPECT_EQ(result.accepted, accepted) << word;
+        EXPECT_EQ(result.error_offset, error_offset) << word;
+        EXPECT_EQ(parser.Parse(word, context), accepted) << word;
+    };
+    expect_result("1+2*3", true, RecognizeResult::kNoError);
+    expect_result("(1+2)*(3)", true, RecognizeResult::kNoError);
+    expect_result("1+*2", false, 2);
+    expect_result("(1+2", false, 4);
+    expect_result("1a", false, 1);
+    expect_result("1$2", false, 1);
+    expect_result("~", false, 0);
+    expect_result(")", false, 0);
+
+    auto allocations_before = allocations_count.load();
+    parser.Recognize("((1+2)*3)+((1+2)*3)", context);
+    EXPECT_EQ(allocations_count.load(), allocations_before);
+}
+
+TEST(Batch, ConcurrentBuildsAreIndependent) {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo reference(grammar);
+    std::vector<std::unique_ptr<Algo>> parsers(8);
+    std::vector<std::thread> builders;
+    for (auto &parser: parsers) {
+        builders.emplace_back([&parser, grammar]() mutable {
+            parser = std::make_unique<Algo>(grammar);
+        });
+    }
+    for (auto &builder: builders) {
+        builder.join();
+    }
+    for (auto &parser: parsers) {
+        ASSERT_EQ(parser->states.size(), reference.states.size());
+        for (size_t i = 0; i < reference.states.size(); ++i) {
+            EXPECT_EQ(parser->states[i].personal_id, static_cast<int>(i));
+        }
+        EXPECT_EQ(parser->table.actions, reference.table.actions);
+        EXPECT_EQ(parser->table.gotos, reference.table.gotos);
+    }
+}
+
+TEST(Batch, ResultsComeInInputOrder) {
+    auto grammar = ReadGrammar("brackets");
+    Algo parser(grammar);
+    auto compiled = parser.Compile();
+    std::mt19937 generator(7);
+    std::string alphabet = "()[]{}";
+    std::vector<std::string> words;
+    for (int i = 0; i < 10000; ++i) {
+        std::string word;
+        for (auto length = generator() % 12; length > 0; --length) {
+            word += alphabet[generator() % alphabet.size()];
+        }
+        words.push_back(i % 3 == 0 ? "(" + word + ")" : word.empty() ? "~" : word);
+    }
+    words.push_back("([]{})");
+
+    auto results = ParseBatch(*compiled, words, 4);
+    ASSERT_EQ(results.size(), words.size());
+    ParseContext context;
+    for (size_t i = 0; i < words.size(); ++i) {
+        auto expected = parser.Recognize(words[i], context);
+        ASSERT_EQ(results[i].accepted, expected.accepted) << words[i];
+        ASSERT_EQ(results[i].error_offset, expected.error_offset) << words[i];
+    }
+    EXPECT_TRUE(results.back().accepted);
+    EXPECT_TRUE(compiled->Parse(words.back(), context));
+    EXPECT_EQ(compiled->Rule(context.reductions.back()), parser.productions[0].rule);
+    EXPECT_TRUE(ParseBatch(*compiled, {}).empty());
+}
+
+TEST(PushParser, ChunkedInputMatchesRecognize) {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo parser(grammar);
+    ParseContext context;
+    std::mt19937 generator(11);
+    std::string alphabet = "+*()123$~";
+    PushParser push_parser(parser);
+    for (int i = 0; i < 3000; ++i) {
+        std::string word;
+        for (auto length = generator() % 14; length > 0; --length) {
+            word += alphabet[generator() % alphabet.size()];
+        }
+        if (i % 2 == 0) {
+            word = "(1+2)*" + word.substr(0, word.size() / 2) + "3";
+        }
+        auto expected = parser.Recognize(word, context);
+
+        push_parser.Reset();
+        for (size_t begin = 0; begin < word.size();) {
+            auto size = std::min<size_t>(1 + generator() % 4, word.size() - begin);
+            push_parser.Feed(std::string_view(word).substr(begin, size));
+            begin += size;
+        }
+        auto status = push_parser.Finish();
+        ASSERT_EQ(status == PushStatus::kAccepted, expected.accepted) << word;
+        ASSERT_EQ(push_parser.ErrorOffset(), expected.error_offset) << word;
+    }
+}
+
+TEST(PushParser, ReportsErrorsBeforeFinish) {
+    auto grammar = ReadGrammar("brackets");
+    Algo parser(grammar);
+    auto compiled = parser.Compile();
+    PushParser push_parser(*compiled);
+    std::string chunk;
+    for (int i = 0; i < 1000; ++i) {
+        chunk += "([]{})";
+    }
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(push_parser.Feed(chunk), PushStatus::kNeedMoreInput);
+    }
+    EXPECT_EQ(push_parser.Consumed(), 100 * chunk.size());
+    EXPECT_EQ(push_parser.Finish(), PushStatus::kAccepted);
+
+    push_parser.Reset();
+    EXPECT_EQ(push_parser.Feed(chunk), PushStatus::kNeedMoreInput);
+    EXPECT_EQ(push_parser.Feed("(]"), PushStatus::kRejected);
+    EXPECT_EQ(push_parser.ErrorOffset(), chunk.size() + 1);
+    EXPECT_EQ(push_parser.Feed(chunk), PushStatus::kRejected);
+    EXPECT_EQ(push_parser.Finish(), PushStatus::kRejected);
+}
+
+TEST(ReduceEvents, SpansOfReductions) {
+    auto grammar = ReadGrammar("brackets");
+    Algo parser(grammar);
+    ParseContext context;
+    std::vector<ReduceEvent> events;
+    ASSERT_TRUE(parser.Parse("()", context, [&events](const ReduceEvent &event) {
+        events.push_back(event);
+    }));
+    std::vector<ReduceEvent> expected = {{4, 1, 1}, {4, 2, 2}, {1, 0, 2}, {0, 0, 2}};
+    EXPECT_EQ(events, expected);
+
+    events.clear();
+    EXPECT_FALSE(parser.Parse("(]", context, [&events](const ReduceEvent &event) {
+        events.push_back(event);
+    }));
+    EXPECT_TRUE(events.empty());
+}
+
+TEST(ReduceEvents, CallbackGeneratorAndParseAgree) {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo parser(grammar);
+    ParseContext context;
+    std::vector<std::string> words = {"1", "1+2*3", "(1+2)*3", "((1))*(2+3)+1", "1+", "(1*2", "~"};
+    for (auto &word: words) {
+        std::vector<ReduceEvent> callback_events;
+        auto accepted = parser.Parse(word, context, [&callback_events](const ReduceEvent &event) {
+            callback_events.push_back(event);
+        });
+        std::vector<ReduceEvent> generator_events;
+        for (auto &event: parser.ReduceEvents(word)) {
+            generator_events.push_back(event);
+        }
+        EXPECT_EQ(generator_events, callback_events) << word;
+        ASSERT_EQ(parser.Parse(word, context), accepted) << word;
+        ASSERT_EQ(callback_events.size(), context.reductions.size()) << word;
+        for (size_t i = 0; i < callback_events.size(); ++i) {
+            EXPECT_EQ(callback_events[i].production, context.reductions[i]) << word;
+            EXPECT_LE(callback_events[i].begin, callback_events[i].end) << word;
+        }
+        auto accepting_event = ReduceEvent{0, 0, word.size()};
+        EXPECT_EQ(!callback_events.empty() && callback_events.back() == accepting_event, accepted) << word;
+    }
+}
+
+TEST(ReduceEvents, DerivationViewMatchesCalculateDerivation) {
+    for (auto name: {"brackets", "arithmetic", "power", "pairs"}) {
+        auto grammar = ReadGrammar(name);
+        Algo parser(grammar);
+        ParseContext context;
+        for (std::string word: {"~", "()[]", "({[]})", "1+2*3", "(1+2)*(3)", "+a^a*a+a", "ccdcd", "dd"}) {
+            std::vector<std::string> derivation_rules;
+            if (!parser.Predict(word, derivation_rules)) {
+                continue;
+            }
+            ASSERT_TRUE(parser.Parse(word, context));
+            DerivationView derivation(parser, context.reductions);
+            EXPECT_EQ(derivation.size(), derivation_rules.size());
+            EXPECT_EQ(derivation.ToString(), CalculateDerivation(derivation_rules)) << name << " " << word;
+        }
+    }
+}
+
+static bool operator==(const ParseTreeNode &first, const ParseTreeNode &second) {
+    return std::tie(first.production, first.child_offset, first.begin, first.end) ==
+           std::tie(second.production, second.child_offset, second.begin, second.end);
+}
+
+TEST(ParseTree, PostOrderLayout) {
+    auto grammar = ReadGrammar("brackets");
+    Algo parser(grammar);
+    ParseContext context;
+    ParseTree tree;
+    ASSERT_TRUE(parser.Parse("()", context, tree));
+    std::vector<ParseTreeNode> expected = {
+            {ParseTree::kTokenNode, 0, 0, 1},
+            {4, 0, 1, 1},
+            {ParseTree::kTokenNode, 0, 1, 2},
+            {4, 0, 2, 2},
+            {1, 4, 0, 2},
+            {0, 5, 0, 2}
+    };
+    EXPECT_EQ(tree.nodes, expected);
+}
+
+TEST(ParseTree, DerivationFromTreeAndFileRoundTrip) {
+    auto path = testing::TempDir() + "parse_tree.clr1";
+    for (auto name: {"brackets", "arithmetic", "power", "pairs"}) {
+        auto grammar = ReadGrammar(name);
+        Algo parser(grammar);
+        ParseContext context;
+        ParseTree tree;
+        for (std::string word: {"~", "()[]", "({[]})", "1+2*3", "(1+2)*(3)", "+a^a*a+a", "ccdcd", "dd"}) {
+            std::vector<std::string> derivation_rules;
+            if (!parser.Predict(word, derivation_rules)) {
+                continue;
+            }
+            ASSERT_TRUE(parser.Parse(word, context, tree));
+            EXPECT_EQ(tree.Root().production, 0);
+            EXPECT_EQ(tree.Root().child_offset + 1, tree.nodes.size());
+            EXPECT_EQ(CalculateDerivation(parser, tree.View()), CalculateDerivation(derivation_rules)) << word;
+
+            tree.Save(path);
+            auto mapped = MapParseTree(path);
+            ASSERT_EQ(mapped.nodes.size(), tree.nodes.size());
+            EXPECT_TRUE(std::equal(mapped.nodes.begin(), mapped.nodes.end(), tree.nodes.begin()));
+            EXPECT_EQ(CalculateDerivation(parser, mapped), CalculateDerivation(derivation_rules)) << word;
+        }
+    }
+    std::ofstream(path, std::ios::trunc) << "not a tree";
+    EXPECT_THROW(MapParseTree(path), TableFileException);
+    std::remove(path.c_str());
+}
+
+TEST(CompressedTable, SameResultsAsDenseTable) {
+    std::mt19937 generator(5);
+    for (auto [name, alphabet]: std::vector<std::pair<std::string, std::string>>{
+            {"brackets", "()[]{}"}, {"arithmetic", "+*()123"}, {"power", "+*^a"}, {"pairs", "cd"}}) {
+        auto grammar = ReadGrammar(name);
+        Algo dense(grammar);
+        BuildOptions options;
+        options.compress_table = true;
+        Algo compressed(grammar, options);
+        ASSERT_NE(compressed.compressed_table, nullptr);
+        auto &table = *compressed.compressed_table;
+        for (size_t state = 0; state < table.state_count; ++state) {
+            for (size_t column = 0; column < table.nonterminal_count; ++column) {
+                ASSERT_EQ(table.Goto(state, column), dense.table.Goto(state, column));
+            }
+        }
+        // Per-state bases and defaults outweigh the savings on the tiniest tables, so only larger ones shrink.
+        if (table.state_count > 20) {
+            EXPECT_LT(table.Bytes(), table.RawBytes()) << name;
+        }
+
+        ParseContext dense_context;
+        ParseContext compressed_context;
+        for (int i = 0; i < 3000; ++i) {
+            std::string word;
+            for (auto length = generator() % 10; length > 0; --length) {
+                word += alphabet[generator() % alphabet.size()];
+            }
+            auto expected = dense.Recognize(word, dense_context);
+            auto result = compressed.Recognize(word, compressed_context);
+            ASSERT_EQ(result.accepted, expected.accepted) << name << " " << word;
+            ASSERT_EQ(result.error_offset, expected.error_offset) << name << " " << word;
+            ASSERT_EQ(compressed.Parse(word, compressed_context), dense.Parse(word, dense_context));
+            ASSERT_EQ(compressed_context.reductions, dense_context.reductions) << name << " " << word;
+        }
+    }
+}
+
+TEST(Profile, RenumberingKeepsLanguageAndPutsHotStatesFirst) {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo reference(grammar);
+    Algo parser(grammar);
+    std::vector<std::string> corpus = {"1+2*3", "(1+2)*3", "1*1*1*1", "((1))", "3+3+3+3+3"};
+    auto profile = ProfileStates(parser, corpus);
+    ASSERT_EQ(profile.visits.size(), parser.states.size());
+    EXPECT_EQ(profile.visits[0], corpus.size());
+
+    auto new_id = ProfileGuidedOrder(profile);
+    std::vector<int> sorted_ids = new_id;
+    std::sort(sorted_ids.begin(), sorted_ids.end());
+    for (size_t i = 0; i < sorted_ids.size(); ++i) {
+        ASSERT_EQ(sorted_ids[i], static_cast<int>(i));
+    }
+    parser.RenumberStates(new_id);
+    EXPECT_EQ(parser.accept_state_id, new_id[reference.accept_state_id]);
+    for (size_t i = 0; i < parser.states.size(); ++i) {
+        EXPECT_EQ(parser.states[i].personal_id, static_cast<int>(i));
+        EXPECT_EQ(parser.StateAlreadyExists(parser.states[i].items), static_cast<int>(i));
+    }
+
+    // Every visited state now comes before every state the corpus never reached.
+    auto reordered = ProfileStates(parser, corpus);
+    auto first_cold = std::find(reordered.visits.begin(), reordered.visits.end(), 0);
+    EXPECT_TRUE(std::all_of(first_cold, reordered.visits.end(), [](std::uint64_t visits) {
+        return visits == 0;
+    }));
+
+    ParseContext context;
+    ParseContext reference_context;
+    for (std::string word: {"1+2*3", "(1+2)*(3+1)", "1+", "(1*2", "~", "2*(3)"}) {
+        ASSERT_EQ(parser.Parse(word, context), reference.Parse(word, reference_context)) << word;
+        EXPECT_EQ(context.reductions, reference_context.reductions) << word;
+    }
+    EXPECT_THROW(parser.RenumberStates(std::vector<int>(parser.states.size(), 0)), std::invalid_argument);
+    auto out_of_range = new_id;
+    out_of_range.back() = static_cast<int>(out_of_range.size());
+    EXPECT_THROW(parser.RenumberStates(out_of_range), std::invalid_argument);
+    out_of_range.back() = -1;
+    EXPECT_THROW(parser.RenumberStates(out_of_range), std::invalid_argument);
+    EXPECT_THROW(parser.RenumberStates({}), std::invalid_argument);
+    for (size_t i = 0; i < parser.states.size(); ++i) {
+        EXPECT_EQ(parser.states[i].personal_id, static_cast<int>(i));
+    }
+    EXPECT_TRUE(parser.Recognize("(1+2)*(3+1)").accepted);
+}
+
+TEST(Lazy, SameResultsAsCanonicalBuild) {
+    std::mt19937 generator(11);
+    for (auto [name, alphabet]: std::vector<std::pair<std::string, std::string>>{
+            {"brackets", "()[]{}"}, {"arithmetic", "+*()123"}, {"power", "+*^a"}, {"pairs", "cd"}}) {
+        auto grammar = ReadGrammar(name);
+        Algo canonical(grammar);
+        BuildOptions options;
+        options.mode = ConstructionMode::kLazy;
+        Algo lazy(grammar, options);
+        ASSERT_NE(lazy.lazy_table, nullptr);
+        EXPECT_TRUE(lazy.states.empty());
+        EXPECT_EQ(lazy.lazy_table->StateCount(), 1);
+        EXPECT_EQ(lazy.lazy_table->BuiltRowCount(), 0);
+
+        ParseContext canonical_context;
+        ParseContext lazy_context;
+        for (int i = 0; i < 2000; ++i) {
+            std::string word;
+            for (auto length = generator() % 8; length > 0; --length) {
+                word += alphabet[generator() % alphabet.size()];
+            }
+            auto expected = canonical.Recognize(word, canonical_context);
+            auto result = lazy.Recognize(word, lazy_context);
+            ASSERT_EQ(result.accepted, expected.accepted) << name << " " << word;
+            ASSERT_EQ(result.error_offset, expected.error_offset) << name << " " << word;
+            ASSERT_EQ(lazy.Parse(word, lazy_context), canonical.Parse(word, canonical_context));
+            ASSERT_EQ(lazy_context.reductions, canonical_context.reductions) << name << " " << word;
+        }
+        EXPECT_LE(lazy.lazy_table->BuiltRowCount(), lazy.lazy_table->StateCount());
+        EXPECT_LE(lazy.lazy_table->StateCount(), canonical.states.size());
+    }
+}
+
+TEST(Lazy, ConcurrentParsesShareOneTable) {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo canonical(grammar);
+    BuildOptions options;
+    options.mode = ConstructionMode::kLazy;
+    Algo lazy(grammar, options);
+    std::vector<std::string> words;
+    std::mt19937 generator(3);
+    std::string alphabet = "+*()123";
+    for (int i = 0; i < 4000; ++i) {
+        std::string word;
+        for (auto length = generator() % 12; length > 0; --length) {
+            word += alphabet[generator() % alphabet.size()];
+        }
+        words.push_back(word);
+    }
+    std::vector<std::vector<RecognizeResult>> results(8, std::vector<RecognizeResult>(words.size()));
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < results.size(); ++worker) {
+        workers.emplace_back([&lazy, &words, &results, worker]() {
+            ParseContext context;
+            for (size_t i = 0; i < words.size(); ++i) {
+                results[worker][(i + worker * 500) % words.size()] =
+                        lazy.Recognize(words[(i + worker * 500) % words.size()], context);
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    for (auto &worker_results: results) {
+        for (size_t i = 0; i < words.size(); ++i) {
+            auto expected = canonical.Recognize(words[i]);
+            ASSERT_EQ(worker_results[i].accepted, expected.accepted) << words[i];
+            ASSERT_EQ(worker_results[i].error_offset, expected.error_offset) << words[i];
+        }
+    }
+}
+
+TEST(Lazy, ConflictsAreReportedWhenReached) {
+    std::vector<std::string> grammar = {"E->E+E",
+                                        "E->a",
+                                        "E"};
+    BuildOptions options;
+    options.mode = ConstructionMode::kLazy;
+    Algo lazy(grammar, options);
+    EXPECT_TRUE(lazy.Recognize("a").accepted);
+    try {
+        lazy.Recognize("a+a");
+        FAIL() << "The conflict was not reported.";
+    } catch (GrammarException &error) {
+        EXPECT_EQ(std::string(error.what()), "Shift/Reduce conflict occurred. The grammar is no LR(1) type.");
+    }
+    EXPECT_THROW(lazy.Compile(), std::logic_error);
+}
+
+TEST(Lazy, TableOutlivesTheParserItCameFrom) {
+    std::vector<std::string> grammar = {"S->aS",
+                                        "S->b",
+                                        "S"};
+    BuildOptions options;
+    options.mode = ConstructionMode::kLazy;
+    std::optional<Algo> original(std::in_place, grammar, options);
+    auto moved = std::move(*original);
+    original.reset();
+    EXPECT_TRUE(moved.Recognize("aab").accepted);
+    EXPECT_FALSE(moved.Recognize("aba").accepted);
+    auto copy = moved;
+    moved = Algo(grammar);
+    EXPECT_TRUE(copy.Recognize("ab").accepted);
+}
+
+TEST(Lazy, CompleteTableUsersAreRejected) {
+    std::vector<std::string> grammar = {"S->aS",
+                                        "S->b",
+                                        "S"};
+    BuildOptions options;
+    options.mode = ConstructionMode::kLazy;
+    Algo lazy(grammar, options);
+    EXPECT_THROW(lazy.Compile(), std::logic_error);
+    EXPECT_THROW(SaveTable(lazy, testing::TempDir() + "lazy.clr1"), std::logic_error);
+    EXPECT_THROW(PushParser{lazy}, std::logic_error);
+    EXPECT_THROW(ParseSession{lazy}, std::logic_error);
+    EXPECT_THROW(ProfileStates(lazy, {"ab"}), std::logic_error);
+    EXPECT_THROW(lazy.RenumberStates({0}), std::logic_error);
+    ParseForest forest;
+    EXPECT_THROW(lazy.Parse("ab", forest), std::logic_error);
+    EXPECT_TRUE(lazy.Recognize("aab").accepted);
+
+    options.compress_table = true;
+    EXPECT_THROW(Algo(grammar, options), std::invalid_argument);
+}
+
+static void ExpectSameBuild(const Algo &edited, const Algo &fresh) {
+    ASSERT_EQ(edited.productions.size(), fresh.productions.size());
+    for (size_t i = 0; i < fresh.productions.size(); ++i) {
+        EXPECT_EQ(edited.productions[i].rule, fresh.productions[i].rule);
+    }
+    EXPECT_EQ(edited.terminals, fresh.terminals);
+    ASSERT_EQ(edited.states.size(), fresh.states.size());
+    for (size_t i = 0; i < fresh.states.size(); ++i) {
+        ASSERT_EQ(edited.states[i].items, fresh.states[i].items) << i;
+        ASSERT_EQ(edited.states[i].transitions, fresh.states[i].transitions) << i;
+    }
+    EXPECT_EQ(edited.accept_state_id, fresh.accept_state_id);
+    EXPECT_EQ(edited.table.column, fresh.table.column);
+    EXPECT_EQ(edited.table.actions, fresh.table.actions);
+    EXPECT_EQ(edited.table.gotos, fresh.table.gotos);
+    EXPECT_EQ(edited.table.production_lengths, fresh.table.production_lengths);
+    EXPECT_EQ(edited.table.production_lhs, fresh.table.production_lhs);
+}
+
+// Every production of every grammar is removed and added back; both edits must match a fresh Fit.
+TEST(GrammarEdit, RemoveAndAddMatchFreshBuild) {
+    size_t reused_states = 0;
+    for (auto name: {"brackets", "arithmetic", "power", "pairs"}) {
+        auto grammar = ReadGrammar(name);
+        for (size_t line = 0; line + 1 < grammar.size(); ++line) {
+            auto rule = grammar[line];
+            auto without_rule = grammar;
+            without_rule.erase(without_rule.begin() + static_cast<std::ptrdiff_t>(line));
+            auto with_rule_last = without_rule;
+            with_rule_last.insert(with_rule_last.end() - 1, rule);
+
+            Algo edited(grammar);
+            std::unique_ptr<Algo> fresh;
+            std::string fresh_error;
+            try {
+                fresh = std::make_unique<Algo>(without_rule);
+            } catch (GrammarException &error) {
+                fresh_error = error.what();
+            }
+            if (!fresh) {
+                try {
+                    edited.RemoveProduction(rule);
+                    FAIL() << name << ": removing " << rule << " must fail like the fresh build";
+                } catch (GrammarException &error) {
+                    EXPECT_EQ(std::string(error.what()), fresh_error);
+                }
+                ExpectSameBuild(edited, Algo(grammar));
+                continue;
+            }
+            edited.RemoveProduction(rule);
+            ExpectSameBuild(edited, *fresh);
+            reused_states += edited.construction_stats.reused_states;
+
+            edited.AddProduction(rule);
+            ExpectSameBuild(edited, Algo(with_rule_last));
+            reused_states += edited.construction_stats.reused_states;
+        }
+    }
+    EXPECT_GT(reused_states, 0);
+}
+
+TEST(GrammarEdit, NewSymbolsAndConflicts) {
+    auto grammar = ReadGrammar("arithmetic");
+    Algo edited(grammar);
+    edited.AddProduction("G->g");
+    edited.AddProduction("F->-G");
+    auto expected_grammar = grammar;
+    expected_grammar.insert(expected_grammar.end() - 1, {"G->g", "F->-G"});
+    Algo expected(expected_grammar);
+    ExpectSameBuild(edited, expected);
+    EXPECT_TRUE(edited.Recognize("-g*(1+-g)").accepted);
+
+    edited.RemoveProduction("F->-G");
+    EXPECT_FALSE(edited.terminals.contains('-'));
+    EXPECT_FALSE(edited.Recognize("-g").accepted);
+    EXPECT_THROW(edited.RemoveProduction("F->-G"), GrammarException);
+
+    Algo conflicting(grammar);
+    EXPECT_THROW(conflicting.AddProduction("E->E*E"), GrammarException);
+    EXPECT_TRUE(conflicting.Recognize("1+1").accepted);
+    ExpectSameBuild(conflicting, Algo(grammar));
+}
+
+// Mostly edits that keep the document in the language, some that break it, and undos of both.
+TEST(ParseSession, RandomEditsMatchRecognize) {
+    std::mt19937 generator(17);
+    for (auto [name, alphabet, insertions]: std::vector<std::tuple<std::string, std::string, std::vector<std::string>>>{
+            {"brackets", "()[]{}", {"()", "[]", "{}", "([])"}}, {"arithmetic", "+*()123", {"1*", "(2+3)*", "3+"}}}) {
+        auto grammar = ReadGrammar(name);
+        Algo parser(grammar);
+        ParseSession session(parser, 8);
+        // A document that is just the epsilon symbol is the empty word, also when an edit produces it.
+        auto expect_recognized = [&parser, &session, &name](RecognizeResult result) {
+            auto expected = parser.Recognize(session.Text());
+            ASSERT_EQ(result.accepted, expected.accepted) << name << " " << session.Text();
+            ASSERT_EQ(result.error_offset, expected.error_offset) << name << " " << session.Text();
+        };
+        expect_recognized(session.Reset("~"));
+        expect_recognized(session.Reset(""));
+        expect_recognized(session.Edit(0, 0, "~"));
+        expect_recognized(session.Edit(1, 0, "~"));
+        expect_recognized(session.Edit(0, 1, ""));
+        expect_recognized(session.Edit(0, 1, "()"));
+        expect_recognized(session.Edit(0, 2, "~"));
+        std::string text = insertions[0];
+        session.Reset(text);
+        auto last_accepted = text;
+        size_t accepted = 0;
+        size_t broken_edits = 0;
+        for (int edit = 0; edit < 3000; ++edit) {
+            size_t offset = 0;
+            size_t erased = 0;
+            std::string inserted;
+            switch (generator() % 4) {
+                case 0:
+                case 1: {
+                    // Inserting before a digit or an opening bracket keeps arithmetic expressions valid.
+                    offset = generator() % (text.size() + 1);
+                    while (name == "arithmetic" && offset < text.size() && text[offset] != '(' &&
+                           !std::isdigit(static_cast<unsigned char>(text[offset]))) {
+                        ++offset;
+                    }
+                    if (name == "arithmetic" && offset == text.size()) {
+                        offset = 0;
+                    }
+                    inserted = insertions[generator() % insertions.size()];
+                    break;
+                }
+                case 2:
+                    offset = generator() % (text.size() + 1);
+                    erased = std::min<size_t>(generator() % 3, text.size() - offset);
+                    inserted = std::string(generator() % 2, alphabet[generator() % alphabet.size()]);
+                    break;
+                default:
+                    break;
+            }
+            auto previous = text;
+            text.replace(offset, erased, inserted);
+            auto result = session.Edit(offset, erased, inserted);
+            ASSERT_EQ(session.Text(), text);
+            auto expected = parser.Recognize(text);
+            ASSERT_EQ(result.accepted, expected.accepted) << name << " " << text;
+            ASSERT_EQ(result.error_offset, expected.error_offset) << name << " " << text;
+            if (result.accepted) {
+                ++accepted;
+                last_accepted = text;
+                broken_edits = 0;
+            } else if (generator() % 8 != 0) {
+                text = previous;
+                result = session.Edit(offset, inserted.size(), previous.substr(offset, erased));
+                ASSERT_EQ(session.Text(), text);
+                ASSERT_EQ(result.accepted, parser.Recognize(text).accepted) << name << " " << text;
+            } else if (++broken_edits == 20) {
+                result = session.Edit(0, text.size(), last_accepted);
+                text = last_accepted;
+                ASSERT_TRUE(result.accepted);
+            }
+        }
+        EXPECT_GT(accepted, 400) << name;
+    }
+}
+
+TEST(ParseSession, SmallEditsRescanLittle) {
+    auto brackets = ReadGrammar("brackets");
+    Algo brackets_parser(brackets);
+    auto arithmetic = ReadGrammar("arithmetic");
+    Algo arithmetic_parser(arithmetic);
+    std::string nested;
+    std::string list = "1";
+    for (int i = 0; i < 20000; ++i) {
+        nested += i % 2 == 0 ? "([]" : "{}";
+        list += "+2*(3+1)";
+    }
+    for (int i = 0; i < 20000; i += 2) {
+        nested += ')';
+    }
+    for (auto [parser, text]: {std::pair{&brackets_parser, nested}, std::pair{&arithmetic_parser, list}}) {
+        ParseSession session(*parser, 64);
+        ASSERT_TRUE(session.Reset(text).accepted);
+        EXPECT_EQ(session.LastScanned(), text.size());
+
+        auto middle = text.size() / 2;
+        auto replaced = text.substr(middle, 2);
+        auto swapped = std::string{replaced[1], replaced[0]};
+        auto broken = session.Edit(middle, 2, swapped);
+        EXPECT_EQ(broken.accepted, parser->Recognize(session.Text()).accepted);
+        EXPECT_LT(session.LastScanned(), 4 * 64);
+        auto repaired = session.Edit(middle, 2, replaced);
+        EXPECT_TRUE(repaired.accepted);
+        EXPECT_EQ(session.Text(), text);
+        EXPECT_LT(session.LastScanned(), 4 * 64);
+    }
+    ParseSession session(arithmetic_parser);
+    session.Reset("1+2");
+    EXPECT_THROW(session.Edit(4, 0, "+3"), std::out_of_range);
+}
+
+// Replays the reductions as a rightmost derivation backwards from the start symbol and compares the result.
+static void ExpectDerives(const Algo &parser, const std::vector<int> &reductions, const std::string &word) {
+    ASSERT_FALSE(reductions.empty());
+    ASSERT_EQ(reductions.back(), 0);
+    std::string form(1, kRealStart);
+    for (auto production = reductions.rbegin(); production != reductions.rend(); ++production) {
+        auto &rule = parser.productions[*production];
+        auto position = form.find_last_of(rule.lhs);
+        ASSERT_NE(position, std::string::npos) << word;
+        ASSERT_EQ(form.find_first_of("ABCDEFGHIJKLMNOPQRSTUVWXYZ@", position + 1), std::string::npos) << word;
+        form.replace(position, 1, rule.symbols);
+    }
+    EXPECT_EQ(form, word == "~" ? "" : word);
+}
+
+TEST(Glr, AmbiguousGrammarKeepsEveryTree) {
+    std::vector<std::string> grammar = {"E->E+E",
+                                        "E->a",
+                                        "E"};
+    EXPECT_THROW(Algo{grammar}, GrammarException);
+    BuildOptions options;
+    options.glr = true;
+    Algo parser(grammar, options);
+    ASSERT_FALSE(parser.table.conflicts.empty());
+
+    ParseForest forest;
+    std::string word = "a";
+    for (std::uint64_t expected: {1, 1, 2, 5, 14, 42}) {
+        ASSERT_TRUE(parser.Parse(word, forest)) << word;
+        EXPECT_EQ(forest.CountTrees(), expected) << word;
+        EXPECT_EQ(forest.IsAmbiguous(), expected > 1) << word;
+        ParseContext context;
+        ASSERT_TRUE(parser.Parse(word, context));
+        ExpectDerives(parser, context.reductions, word);
+        word += "+a";
+    }
+    EXPECT_FALSE(parser.Parse("a+", forest));
+    EXPECT_EQ(forest.root, ParseForest::kNoNode);
+    EXPECT_EQ(parser.Recognize("a+").error_offset, 2);
+    EXPECT_EQ(parser.Recognize("a+b").error_offset, 2);
+    EXPECT_EQ(parser.Recognize("aa").error_offset, 1);
+    EXPECT_TRUE(parser.Recognize("a+a+a").accepted);
+
+    EXPECT_THROW(parser.Compile(), std::logic_error);
+    EXPECT_THROW(PushParser{parser}, std::logic_error);
+    EXPECT_THROW(parser.ReduceEvents("a"), std::logic_error);
+    options.mode = ConstructionMode::kLazy;
+    EXPECT_THROW(Algo(grammar, options), std::invalid_argument);
+}
+
+TEST(Glr, NonLrGrammars) {
+    std::vector<std::string> palindromes = {"S->aSa",
+                                            "S->bSb",
+                                            "S->a",
+                                            "S->b",
+                                            "S"};
+    EXPECT_THROW(Algo{palindromes}, GrammarException);
+    BuildOptions options;
+    options.glr = true;
+    Algo parser(palindromes, options);
+    std::vector<std::string> words = {""};
+    for (size_t begin = 0, length = 1; length <= 9; ++length) {
+        auto end = words.size();
+        for (auto i = begin; i < end; ++i) {
+            words.push_back(words[i] + 'a');
+            words.push_back(words[i] + 'b');
+        }
+        begin = end;
+    }
+    ParseForest forest;
+    for (auto &word: words) {
+        auto expected = word.size() % 2 == 1 && std::equal(word.begin(), word.end(), word.rbegin());
+        ASSERT_EQ(parser.Parse(word, forest), expected) << word;
+        if (expected) {
+            EXPECT_EQ(forest.CountTrees(), 1) << word;
+            std::vector<int> reductions;
+            ASSERT_TRUE(forest.FirstDerivation(reductions));
+            ExpectDerives(parser, reductions, word);
+        }
+    }
+
+    // Nullable and cyclic: S->SS with S->~ derives every word in infinitely many ways.
+    std::vector<std::string> brackets = {"S->SS",
+                                         "S->(S)",
+                                         "S->~",
+                                         "S"};
+    Algo cyclic(brackets, options);
+    for (std::string word: {"~", "()", "()()", "(()())()"}) {
+        ASSERT_TRUE(cyclic.Parse(word, forest)) << word;
+        EXPECT_EQ(forest.CountTrees(), std::numeric_limits<std::uint64_t>::max()) << word;
+        ParseContext context;
+        ASSERT_TRUE(cyclic.Parse(word, context));
+        ExpectDerives(cyclic, context.reductions, word);
+    }
+    EXPECT_EQ(cyclic.Recognize("(()").error_offset, 3);
+    EXPECT_EQ(cyclic.Recognize("())(").error_offset, 2);
+}
+
+TEST(Glr, DeterministicStretchesBetweenConflicts) {
+    // E->E-E is ambiguous but derives the same words as the LR(1) E->E-T.
+    auto grammar = ReadGrammar("arithmetic");
+    auto reference_grammar = grammar;
+    grammar.insert(grammar.end() - 1, "E->E-E");
+    reference_grammar.insert(reference_grammar.end() - 1, "E->E-T");
+    BuildOptions options;
+    options.glr = true;
+    Algo parser(grammar, options);
+    ASSERT_FALSE(parser.table.conflicts.empty());
+    Algo reference(reference_grammar);
+    std::mt19937 generator(13);
+    std::string alphabet = "+-*()123";
+    ParseContext context;
+    size_t accepted = 0;
+    for (int i = 0; i < 5000; ++i) {
+        std::string word;
+        for (auto length = 1 + generator() % 15; length > 0; --length) {
+            word += alphabet[generator() % alphabet.size()];
+        }
+        auto expected = reference.Recognize(word);
+        auto result = parser.Recognize(word, context);
+        ASSERT_EQ(result.accepted, expected.accepted) << word;
+        ASSERT_EQ(result.error_offset, expected.error_offset) << word;
+        if (expected.accepted) {
+            ++accepted;
+            ASSERT_TRUE(parser.Parse(word, context));
+            ExpectDerives(parser, context.reductions, word);
+        }
+    }
+    EXPECT_GT(accepted, 100);
+    ParseForest forest;
+    // The trailing +T can close any E ending before it, so five operands group like a binary operator chain.
+    ASSERT_TRUE(parser.Parse("(1+2)*3-1-2-3+(1*2)", forest));
+    EXPECT_EQ(forest.CountTrees(), 14);
+}
+
+TEST(Glr, LrGrammarsMatchTheLrDriver) {
+    std::mt19937 generator(5);
+    for (auto [name, alphabet]: std::vector<std::pair<std::string, std::string>>{
+            {"brackets", "()[]{}"}, {"arithmetic", "+*()123"}, {"power", "+*^a"}, {"pairs", "cd"}}) {
+        auto grammar = ReadGrammar(name);
+        BuildOptions options;
+        options.glr = true;
+        Algo parser(grammar, options);
+        ASSERT_TRUE(parser.table.conflicts.empty());
+        ParseContext context;
+        ParseForest forest;
+        std::vector<int> reductions;
+        for (int i = 0; i < 2000; ++i) {
+            std::string word;
+            for (auto length = generator() % 10; length > 0; --length) {
+                word += alphabet[generator() % alphabet.size()];
+            }
+            auto expected = parser.Parse(word, context);
+            ASSERT_EQ(parser.Parse(word, forest), expected) << name << " " << word;
+            if (expected) {
+                EXPECT_EQ(forest.CountTrees(), 1) << name << " " << word;
+                EXPECT_FALSE(forest.IsAmbiguous());
+                ASSERT_TRUE(forest.FirstDerivation(reductions));
+                ASSERT_EQ(reductions, context.reductions) << name << " " << word;
+            }
+        }
+    }
+}
+
+// Evaluates an arithmetic word from its reductions: digits push their value, rules with '+', '-' or '*' combine
+// the two topmost values, every other rule leaves the stack alone.
+static std::int64_t Evaluate(const Algo &parser, const std::vector<int> &reductions) {
+    std::vector<std::int64_t> values;
+    for (auto production: reductions) {
+        auto &symbols = parser.productions[production].symbols;
+        if (symbols.size() == 1 && std::isdigit(static_cast<unsigned char>(symbols[0]))) {
+            values.push_back(symbols[0] - '0');
+            continue;
+        }
+        auto operation = symbols.find_first_of("+-*");
+        if (symbols.size() != 3 || operation != 1) {
+            continue;
+        }
+        auto right = values.back();
+        values.pop_back();
+        auto &left = values.back();
+        left = symbols[1] == '+' ? left + right : symbols[1] == '-' ? left - right : left * right;
+    }
+    return values.empty() ? 0 : values.back();
+}
+
+TEST(Precedence, CompactGrammarMatchesStratifiedOne) {
+    auto stratified_grammar = ReadGrammar("arithmetic");
+    auto compact_grammar = ReadGrammar("arithmetic_precedence");
+    Algo stratified(stratified_grammar);
+    Algo compact(compact_grammar);
+    EXPECT_LT(compact.states.size(), stratified.states.size());
+    std::vector<std::string> undeclared(compact_grammar.begin() + 2, compact_grammar.end());
+    EXPECT_THROW(Algo{undeclared}, GrammarException);
+    BuildOptions options;
+    options.glr = true;
+    EXPECT_TRUE(Algo(compact_grammar, options).table.conflicts.empty());
+
+    std::mt19937 generator(9);
+    std::string alphabet = "+*()123";
+    ParseContext stratified_context;
+    ParseContext compact_context;
+    size_t accepted = 0;
+    for (int i = 0; i < 20000; ++i) {
+        std::string word;
+        for (auto length = 1 + generator() % 11; length > 0; --length) {
+            word += alphabet[generator() % alphabet.size()];
+        }
+        auto expected = stratified.Recognize(word, stratified_context);
+        auto result = compact.Recognize(word, compact_context);
+        ASSERT_EQ(result.accepted, expected.accepted) << word;
+        ASSERT_EQ(result.error_offset, expected.error_offset) << word;
+        if (expected.accepted) {
+            ++accepted;
+            ASSERT_TRUE(stratified.Parse(word, stratified_context));
+            ASSERT_TRUE(compact.Parse(word, compact_context));
+            ASSERT_EQ(Evaluate(compact, compact_context.reductions),
+                      Evaluate(stratified, stratified_context.reductions)) << word;
+            EXPECT_LT(compact_context.reductions.size(), stratified_context.reductions.size()) << word;
+        }
+    }
+    EXPECT_GT(accepted, 500);
+}
+
+TEST(Precedence, AssociativityAndDeclarationErrors) {
+    ParseContext context;
+    for (auto [declaration, value]: std::vector<std::pair<std::string, std::int64_t>>{{"%left-", 0},
+                                                                                     {"%right-", 2}}) {
+        std::vector<std::string> grammar = {declaration, "E->E-E", "E->1", "E->2", "E->3", "E"};
+        Algo parser(grammar);
+        ASSERT_TRUE(parser.Parse("3-2-1", context)) << declaration;
+        EXPECT_EQ(Evaluate(parser, context.reductions), value) << declaration;
+    }
+
+    std::vector<std::string> comparison = {"%nonassoc<", "%left+", "E->E<E", "E->E+E", "E->1", "E"};
+    Algo parser(comparison);
+    EXPECT_TRUE(parser.Recognize("1+1<1+1").accepted);
+    EXPECT_EQ(parser.Recognize("1<1<1").error_offset, 3);
+
+    std::vector<std::string> left = {"%left+", "E->E+E", "E->1", "E"};
+    std::vector<std::string> right = {"%right+", "E->E+E", "E->1", "E"};
+    EXPECT_NE(Algo(left).GrammarHash(), Algo(right).GrammarHash());
+
+    for (auto [declaration, message]: std::vector<std::pair<std::string, std::string>>{
+            {"%left", "The precedence declaration lists no terminals."},
+            {"%middle+", "Unknown grammar declaration."},
+            {"%leftE", "Only terminals can have a precedence."},
+            {"%right++", "The precedence of a terminal is declared twice."}}) {
+        std::vector<std::string> grammar = {declaration, "E->E+E", "E->1", "E"};
+        try {
+            Algo invalid(grammar);
+            FAIL() << declaration;
+        } catch (GrammarException &error) {
+            EXPECT_EQ(std::string(error.what()), message);
+        }
+    }
+}
+
+// After "E+E" with '+' ahead, both reductions lose to the shift under %right, which must not hide that they
+// also conflict with each other.
+TEST(Precedence, ReductionsResolvedAgainstAShiftStillConflict) {
+    std::vector<std::string> grammar = {"%right+", "S->E", "S->G+1", "E->E+E", "E->1", "G->E+E", "S"};
+    try {
+        Algo parser(grammar);
+        FAIL() << "the reduce/reduce conflict on '+' must be reported";
+    } catch (GrammarException &error) {
+        EXPECT_EQ(std::string(error.what()), "Reduce/Reduce conflict occurred. The grammar is no LR(1) type.");
+    }
+
+    BuildOptions options;
+    options.glr = true;
+    Algo parser(grammar, options);
+    EXPECT_TRUE(std::any_of(parser.table.conflicts.begin(), parser.table.conflicts.end(), [](auto &conflicting) {
+        return std::count_if(conflicting.begin(), conflicting.end(), [](auto action) {
+            return ParseTable::TypeOf(action) == ActionType::kReduce;
+        }) == 2;
+    }));
+    EXPECT_TRUE(parser.Recognize("1+1+1").accepted);
+    EXPECT_TRUE(parser.Recognize("1+1+1+1").accepted);
+    EXPECT_FALSE(parser.Recognize("1+").accepted);
+}
+
+TEST(Exceptions, ShiftReduceConflict) {
+
+    std::vector<std::string> grammar = {"S->E",
+                                        "E->T",
+                                        "E->(E)",
+                                        "T->n",
+                                        "T->+T",
+                                        "T->T+n",
+                                        "S"};
+    try {
+        Algo parser(grammar);
+    } catch (std::runtime_error &error) {
+        ASSERT_EQ(std::string(error.what()), "Shift/Reduce conflict occurred. The grammar is no LR(1) type.");
+    }
+
+    grammar = {"S->RS",
+               "S->R",
+               "R->abT",
+               "T->aT",
+               "T->c",
+               "T->~",
+               "S"};
+    try {
+        Algo parser(grammar);
+    } catch (std::runtime_error &error) {
+        ASSERT_EQ(std::string(error.what()), "Shift/Reduce conflict occurred. The grammar is no LR(1) type.");
+    }
+
+}
+
+
+TEST(Exceptions, ReduceReduceConflict) {
+    std::vector<std::string> grammar = {"S->AB",
+                                        "A->~",
+                                        "B->c",
+                                        "B->d",
+                                        "B->D",
+                                        "D->n",
+                                        "D->BA",
+                                        "S"};
+    try {
+        Algo parser(grammar);
+    } catch (std::runtime_error &error) {
+        ASSERT_EQ(std::string(error.what()), "Reduce/Reduce conflict occurred. The grammar is no LR(1) type.");
+    }
+
+    grammar = {"S->X",
+               "X->Y",
+               "X->1",
+               "Y->1"
+               "S"};
+
+    try {
+        Algo parser(grammar);
+    } catch (std::runtime_error &error) {
+        ASSERT_EQ(std::string(error.what()), "Reduce/Reduce conflict occurred. The grammar is no LR(1) type.");
+    }
+}
+
+TEST(Exceptions, UselessCharacters) {
+    std::vector<std::string> grammar = {"S->S+A",
+                                        "A->A*B",
+                                        "A->B",
+                                        "B->C^B",
+                                        "B->C",
+                                        "C->a",
+                                        "S"};
+    try {
+        Algo parser(grammar);
+    } catch (std::runtime_error &error) {
+        ASSERT_EQ(std::string(error.what()), "The grammar contains useless characters.");
+    }
+}
+
+TEST(Exceptions, RulesAbsence) {
+    std::vector<std::string> grammar = {"S"};
+    try {
+        Algo parser(grammar);
+    } catch (std::runtime_error &error) {
+        ASSERT_EQ(std::string(error.what()), "The grammar is incorrect. There are no reachable symbols.");
+    }
+}
+
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
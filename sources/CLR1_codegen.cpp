@@ -0,0 +1,295 @@
+
+#include "CLR1_codegen.h"
+#include <iomanip>
+#include <sstream>
+
+static std::string EscapeForLiteral(const std::string &text) {
+    std::ostringstream escaped;
+    for (auto symbol: text) {
+        auto code = static_cast<unsigned char>(symbol);
+        if (symbol == '"' || symbol == '\\') {
+            escaped << '\\' << symbol;
+        } else if (code < 32 || code > 126) {
+            escaped << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>(code) << std::dec;
+        } else {
+            escaped << symbol;
+        }
+    }
+    return escaped.str();
+}
+
+template<typename T>
+static void EmitArray(std::ostringstream &out, const std::string &type, const std::string &name,
+                      const T *values, size_t count) {
+    out << "inline constexpr " << type << " " << name << "[] = {";
+    for (size_t i = 0; i < count; ++i) {
+        out << (i % 16 == 0 ? "\n        " : " ") << values[i] << (i + 1 == count ? "" : ",");
+    }
+    // Zero-length arrays are not allowed, so empty tables get a single unused entry.
+    out << (count == 0 ? "0" : "") << "\n};\n";
+}
+
+static void EmitPrologue(std::ostringstream &out, const Algo &parser, const std::string &name,
+                         const std::string &backend) {
+    std::string guard;
+    for (auto symbol: name) {
+        guard += static_cast<char>(std::toupper(static_cast<unsigned char>(symbol)));
+    }
+    guard += "_H";
+
+    auto table_view = parser.View();
+    out << "// Generated by CLR1_codegen (" << backend << " backend) for the grammar:\n";
+    for (auto &production: parser.productions) {
+        out << "//   " << production.lhs << "->" << production.rhs << "\n";
+    }
+    out << "\n#ifndef " << guard << "\n#define " << guard << "\n\n";
+    out << "#include <cstdint>\n#include <string_view>\n#include <vector>\n\n";
+    out << "namespace " << name << " {\n\n";
+    out << "inline constexpr std::size_t kTerminalCount = " << table_view.terminal_count << ";\n";
+    out << "inline constexpr std::size_t kNonTerminalCount = " << table_view.nonterminal_count << ";\n";
+    out << "inline constexpr int kEndColumn = " << table_view.Column(kEndOfLine) << ";\n\n";
+    EmitArray(out, "int", "kColumn", table_view.column, 256);
+    out << "\ninline constexpr std::string_view kRules[] = {";
+    for (size_t i = 0; i < parser.productions.size(); ++i) {
+        out << "\n        \"" << EscapeForLiteral(parser.productions[i].rule) << "\""
+            << (i + 1 == parser.productions.size() ? "" : ",");
+    }
+    out << "\n};\n\n";
+    out << "// Returns the action column of the symbol at `position`, the end marker column past the end, or -1.\n"
+        << "inline int LookaheadColumn(std::string_view input, std::size_t position) {\n"
+        << "    if (position == input.size()) {\n"
+        << "        return kEndColumn;\n"
+        << "    }\n"
+        << "    if (input[position] == '" << kEndOfLine << "') {\n"
+        << "        return -1;\n"
+        << "    }\n"
+        << "    return kColumn[static_cast<unsigned char>(input[position])];\n"
+        << "}\n\n";
+}
+
+static void EmitEpilogue(std::ostringstream &out, const std::string &name) {
+    out << "}  // namespace " << name << "\n\n#endif\n";
+}
+
+static std::string GenerateTableParser(const Algo &parser, const std::string &name) {
+    std::ostringstream out;
+    auto table_view = parser.View();
+    EmitPrologue(out, parser, name, "table");
+    EmitArray(out, "std::uint32_t", "kActions", table_view.actions,
+              table_view.state_count * table_view.terminal_count);
+    out << "\n";
+    EmitArray(out, "int", "kGotos", table_view.gotos, table_view.state_count * table_view.nonterminal_count);
+    out << "\n";
+    EmitArray(out, "std::uint32_t", "kLengths", table_view.production_lengths, parser.productions.size());
+    out << "\n";
+    EmitArray(out, "int", "kLhs", table_view.production_lhs, parser.productions.size());
+    out << "\n"
+        << "inline bool Parse(std::string_view input, std::vector<int> *reductions = nullptr) {\n"
+        << "    if (input == \"" << EscapeForLiteral(std::string{kEpsilon}) << "\") {\n"
+        << "        input = {};\n"
+        << "    }\n"
+        << "    std::vector<int> stack{0};\n"
+        << "    std::size_t position = 0;\n"
+        << "    while (true) {\n"
+        << "        auto column = LookaheadColumn(input, position);\n"
+        << "        if (column < 0) {\n"
+        << "            return false;\n"
+        << "        }\n"
+        << "        auto action = kActions[stack.back() * kTerminalCount + column];\n"
+        << "        auto value = static_cast<int>(action >> " << kActionTypeBits << ");\n"
+        << "        switch (action & " << kActionTypeMask << "u) {\n"
+        << "            case " << static_cast<int>(ActionType::kShift) << ":\n"
+        << "                stack.push_back(value);\n"
+        << "                ++position;\n"
+        << "                break;\n"
+        << "            case " << static_cast<int>(ActionType::kReduce) << ": {\n"
+        << "                if (reductions != nullptr) {\n"
+        << "                    reductions->push_back(value);\n"
+        << "                }\n"
+        << "                stack.resize(stack.size() - kLengths[value]);\n"
+        << "                auto next_state = kGotos[stack.back() * kNonTerminalCount + kLhs[value]];\n"
+        << "                if (next_state < 0) {\n"
+        << "                    return false;\n"
+        << "                }\n"
+        << "                stack.push_back(next_state);\n"
+        << "                break;\n"
+        << "            }\n"
+        << "            case " << static_cast<int>(ActionType::kAccept) << ":\n"
+        << "                if (reductions != nullptr) {\n"
+        << "                    reductions->push_back(0);\n"
+        << "                }\n"
+        << "                return true;\n"
+        << "            default:\n"
+        << "                return false;\n"
+        << "        }\n"
+        << "    }\n"
+        << "}\n\n";
+    EmitEpilogue(out, name);
+    return out.str();
+}
+
+// Every state function handles one stack entry. A reduction by a rule of length n returns through n state
+// functions; the function reached after that performs the goto on the reduced nonterminal and continues.
+// Rules of length zero do not pop anything, so their goto is resolved statically in the reducing state.
+static std::string GenerateRecursiveAscentParser(const Algo &parser, const std::string &name) {
+    std::ostringstream out;
+    auto table_view = parser.View();
+    EmitPrologue(out, parser, name, "recursive ascent");
+    EmitArray(out, "std::uint32_t", "kLengths", table_view.production_lengths, parser.productions.size());
+    out << "\n";
+    EmitArray(out, "int", "kLhs", table_view.production_lhs, parser.productions.size());
+    out << "\n"
+        << "struct Context {\n"
+        << "    std::string_view input;\n"
+        << "    std::size_t position = 0;\n"
+        << "    std::vector<int> *reductions = nullptr;\n"
+        << "    std::uint32_t pops = 0;\n"
+        << "    int lhs = -1;\n"
+        << "    bool finished = false;\n"
+        << "    bool accepted = false;\n"
+        << "\n"
+        << "    void Reduce(int production) {\n"
+        << "        if (reductions != nullptr) {\n"
+        << "            reductions->push_back(production);\n"
+        << "        }\n"
+        << "        pops = kLengths[production];\n"
+        << "        lhs = kLhs[production];\n"
+        << "    }\n"
+        << "\n"
+        << "    void Finish(bool accept) {\n"
+        << "        if (accept && reductions != nullptr) {\n"
+        << "            reductions->push_back(0);\n"
+        << "        }\n"
+        << "        finished = true;\n"
+        << "        accepted = accept;\n"
+        << "    }\n"
+        << "};\n\n";
+
+    for (size_t state = 0; state < table_view.state_count; ++state) {
+        out << "inline void State" << state << "(Context &context);\n";
+    }
+    out << "\n";
+
+    for (size_t i = 0; i < table_view.state_count; ++i) {
+        auto state = static_cast<int>(i);
+        std::map<int, std::vector<int>> shifts;
+        std::map<int, std::vector<int>> reductions;
+        std::vector<int> accepts;
+        std::set<int> callees;
+        for (size_t column = 0; column < table_view.terminal_count; ++column) {
+            auto action = table_view.Action(state, static_cast<int>(column));
+            auto value = ParseTable::ValueOf(action);
+            switch (ParseTable::TypeOf(action)) {
+                case ActionType::kShift:
+                    shifts[value].push_back(static_cast<int>(column));
+                    callees.insert(value);
+                    break;
+                case ActionType::kReduce:
+                    reductions[value].push_back(static_cast<int>(column));
+                    break;
+                case ActionType::kAccept:
+                    accepts.push_back(static_cast<int>(column));
+                    break;
+                default:
+                    break;
+            }
+        }
+        std::map<int, int> gotos;
+        for (size_t column = 0; column < table_view.nonterminal_count; ++column) {
+            auto next_state = table_view.Goto(state, static_cast<int>(column));
+            if (next_state != kNoState) {
+                gotos[static_cast<int>(column)] = next_state;
+                callees.insert(next_state);
+            }
+        }
+        auto emit_cases = [&out](const std::vector<int> &columns) {
+            for (auto column: columns) {
+                out << "        case " << column << ":\n";
+            }
+        };
+
+        out << "inline void State" << state << "(Context &context) {\n"
+            << "    int next_state = -1;\n"
+            << "    switch (LookaheadColumn(context.input, context.position)) {\n";
+        for (auto &[next_state, columns]: shifts) {
+            emit_cases(columns);
+            out << "            ++context.position;\n"
+                << "            next_state = " << next_state << ";\n"
+                << "            break;\n";
+        }
+        for (auto &[production, columns]: reductions) {
+            emit_cases(columns);
+            out << "            context.Reduce(" << production << ");\n";
+            if (table_view.production_lengths[production] != 0) {
+                out << "            return;\n";
+                continue;
+            }
+            auto next_state = table_view.Goto(state, table_view.production_lhs[production]);
+            if (next_state == kNoState) {
+                out << "            context.Finish(false);\n"
+                    << "            return;\n";
+                continue;
+            }
+            callees.insert(next_state);
+            out << "            next_state = " << next_state << ";\n"
+                << "            break;\n";
+        }
+        if (!accepts.empty()) {
+            emit_cases(accepts);
+            out << "            context.Finish(true);\n"
+                << "            return;\n";
+        }
+        out << "        default:\n"
+            << "            context.Finish(false);\n"
+            << "            return;\n"
+            << "    }\n"
+            << "    while (true) {\n"
+            << "        switch (next_state) {\n";
+        for (auto callee: callees) {
+            out << "            case " << callee << ":\n"
+                << "                State" << callee << "(context);\n"
+                << "                break;\n";
+        }
+        out << "            default:\n"
+            << "                break;\n"
+            << "        }\n"
+            << "        if (context.finished || --context.pops > 0) {\n"
+            << "            return;\n"
+            << "        }\n"
+            << "        switch (context.lhs) {\n";
+        for (auto &[column, next_state]: gotos) {
+            out << "            case " << column << ":\n"
+                << "                next_state = " << next_state << ";\n"
+                << "                break;\n";
+        }
+        out << "            default:\n"
+            << "                context.Finish(false);\n"
+            << "                return;\n"
+            << "        }\n"
+            << "    }\n"
+            << "}\n\n";
+    }
+
+    out << "inline bool Parse(std::string_view input, std::vector<int> *reductions = nullptr) {\n"
+        << "    if (input == \"" << EscapeForLiteral(std::string{kEpsilon}) << "\") {\n"
+        << "        input = {};\n"
+        << "    }\n"
+        << "    Context context;\n"
+        << "    context.input = input;\n"
+        << "    context.reductions = reductions;\n"
+        << "    State0(context);\n"
+        << "    return context.accepted;\n"
+        << "}\n\n";
+    EmitEpilogue(out, name);
+    return out.str();
+}
+
+std::string GenerateParser(const Algo &parser, const std::string &name, CodegenBackend backend) {
+    RequireCompleteTable(parser);
+    RequireDeterministicTable(parser);
+    if (backend == CodegenBackend::kTable) {
+        return GenerateTableParser(parser, name);
+    }
+    return GenerateRecursiveAscentParser(parser, name);
+}
+
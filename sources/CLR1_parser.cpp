@@ -1,524 +1,3103 @@
-
-#include "CLR1_parser.h"
-
-// class Item
-Item::Item(char rule_lhs,
-           std::string rule_rhs,
-           int dot_pos,
-           const std::set<char> &new_lookaheads) :
-        lhs(rule_lhs),
-        rhs(rule_rhs),
-        lookaheads(new_lookaheads) {
-    rhs.insert(rhs.begin() + dot_pos, '.');
-}
-
-Item::Item(char rule_lhs,
-           std::string rule_rhs_with_dot,
-           const std::set<char> &new_lookaheads) :
-        lhs(rule_lhs),
-        rhs(rule_rhs_with_dot),
-        lookaheads(new_lookaheads) {
-}
-
-bool Item::operator==(Item &second) {
-    if (lhs != second.lhs) {
-        return false;
-    }
-    if (rhs != second.rhs) {
-        return false;
-    }
-    if (lookaheads != second.lookaheads) {
-        return false;
-    }
-    return true;
-}
-
-bool Item::operator<(Item &second) {
-    if (lhs < second.lhs) {
-        return true;
-    }
-    if (lhs == second.lhs) {
-        if (rhs < second.rhs) {
-            return true;
-        }
-        if (rhs == second.rhs) {
-            if (lookaheads < second.lookaheads) {
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
-bool Item::operator!=(Item &second) {
-    return !operator==(second);
-}
-
-// class State
-
-int State::counter_id = 0;
-State::State(const std::vector<Item> &new_items) : items(new_items), personal_id(counter_id++) {
-}
-
-// class Algo
-
-Algo::Algo(std::vector<std::string> &grammar) {
-    Fit(grammar);
-}
-
-void Algo::Fit(std::vector<std::string> &grammar) {
-    ProcessInputGrammar(grammar);
-    for (auto &nonterminal: nonterminals) {
-        if (nonterminal.first == kRealStart) {
-            continue;
-        }
-        std::set<char> symbols_in_lhs;
-        symbols_in_lhs.insert(nonterminal.first);
-        CalculateFirstOfSymbol(nonterminal.first, symbols_in_lhs);
-    }
-    State::counter_id = 0;
-    CalculateStates();
-    MakeTable();
-}
-
-void Algo::ProcessInputGrammar(std::vector<std::string> &grammar) {
-    std::string delimiter = "->";
-    for (auto &rule: grammar) {
-        if (rule.size() == 1) {
-            break;
-        }
-        auto delimiter_pos = rule.find(delimiter);
-        auto lhs_part_substr = rule.substr(0, delimiter_pos);
-        if (lhs_part_substr.size() != 1 || !std::isupper(lhs_part_substr[0])) {
-            throw GrammarException("The grammar contains incorrect LHS part.");
-        }
-        auto lhs_part = lhs_part_substr[0];
-        auto rhs_part = rule.substr(delimiter_pos + 2);
-        if (!production_rules.contains(lhs_part)) {
-            production_rules[lhs_part] = std::vector<std::string>();
-        }
-        production_rules[lhs_part].push_back(rhs_part);
-
-        if (!nonterminals.contains(lhs_part)) {
-            nonterminals[lhs_part] = NonTerminal(lhs_part);
-        }
-
-        for (auto symbol: rhs_part) {
-            if (symbol >= kNonTerminalAlphabetBeg && symbol <= kNonTerminalAlphabetEnd) {
-                if (!nonterminals.contains(symbol)) {
-                    nonterminals[symbol] = NonTerminal(symbol);
-                }
-            } else {
-                if (!terminals.contains(symbol)) {
-                    terminals.insert(symbol);
-                }
-            }
-        }
-    }
-    nonterminals[kRealStart] = NonTerminal(kRealStart);
-    production_rules[kRealStart].push_back(grammar[grammar.size() - 1]);
-}
-
-std::set<char> Algo::CalculateFirstOfSymbol(char curr_symbol, std::set<char> &symbols_in_lhs) {
-    if (terminals.contains(curr_symbol)) {
-        return {curr_symbol};
-    }
-
-    bool eps_as_rhs_term = false;
-
-    for (auto &rule: production_rules[curr_symbol]) {
-        if (terminals.contains(rule[0])) {
-            nonterminals[curr_symbol].first.insert(rule[0]);
-            if (rule[0] == kEpsilon) {
-                eps_as_rhs_term = true;
-            }
-        }
-    }
-
-    for (auto &rule: production_rules[curr_symbol]) {
-        for (auto symbol_in_rule: rule) {
-            std::set<char> first_of_current;
-            if (!symbols_in_lhs.contains(symbol_in_rule)) {
-                if (nonterminals.contains(symbol_in_rule)) {
-                    symbols_in_lhs.insert(symbol_in_rule);
-                }
-                first_of_current = CalculateFirstOfSymbol(symbol_in_rule, symbols_in_lhs);
-            } else {
-                first_of_current = nonterminals[symbol_in_rule].first;
-            }
-            nonterminals[curr_symbol].first.insert(first_of_current.begin(), first_of_current.end());
-            if (!first_of_current.contains(kEpsilon)) {
-                if (auto eps_in_first = nonterminals[curr_symbol].first.find(kEpsilon);
-                        (!eps_as_rhs_term) && eps_in_first != nonterminals[curr_symbol].first.end()) {
-                    nonterminals[curr_symbol].first.erase(eps_in_first);
-                }
-                break;
-            }
-        }
-    }
-
-    if (nonterminals[curr_symbol].first.empty()) {
-        throw GrammarException("The grammar contains useless characters.");
-    }
-
-    return nonterminals[curr_symbol].first;
-}
-
-std::set<char> Algo::CalculateFirstOfChain(std::string chain) {
-    std::set<char> first_of_chain;
-    for (auto letter: chain) {
-        if (nonterminals.contains(letter)) {
-            first_of_chain.insert(nonterminals[letter].first.begin(), nonterminals[letter].first.end());
-        } else {
-            first_of_chain.insert(letter);
-            if (auto eps_in_set = first_of_chain.find(kEpsilon); eps_in_set != first_of_chain.end()) {
-                first_of_chain.erase(eps_in_set);
-            }
-            break;
-        }
-        if (!nonterminals[letter].first.contains(kEpsilon)) {
-            if (auto eps_in_set = first_of_chain.find(kEpsilon); eps_in_set != first_of_chain.end()) {
-                first_of_chain.erase(eps_in_set);
-            }
-            break;
-        }
-
-    }
-    return first_of_chain;
-}
-
-bool Algo::ItemIsInSet(Item &curr_item, std::vector<Item> &items) {
-    for (auto &item: items) {
-        if (curr_item.lhs != item.lhs || curr_item.rhs != item.rhs) {
-            continue;
-        }
-
-        std::set<char> lookaheads_union;
-        std::set_union(curr_item.lookaheads.begin(), curr_item.lookaheads.end(), item.lookaheads.begin(),
-                       item.lookaheads.end(), std::inserter(lookaheads_union, lookaheads_union.begin()));
-        item.lookaheads = std::move(lookaheads_union);
-        return true;
-    }
-    return false;
-}
-
-std::vector<Item> Algo::Closure(std::vector<Item> items) {
-    std::vector<Item> new_items_set = items;
-    for (size_t i = 0; i < new_items_set.size(); ++i) {
-        auto &item = new_items_set[i];
-        auto dot_pos = item.rhs.find('.');
-        if (dot_pos == item.rhs.size() - 1) {
-            continue;
-        }
-        auto after_dot = item.rhs.substr(dot_pos + 1);
-        if (nonterminals.contains(after_dot[0])) {
-            std::set<char> new_lookaheads;
-            std::set<char> first_of_right;
-            if (after_dot.size() > 1) {
-                first_of_right = CalculateFirstOfChain(after_dot.substr(1));
-                for (auto letter: first_of_right) {
-                    if (letter == kEpsilon) {
-                        for (auto lookahead: item.lookaheads) {
-                            new_lookaheads.insert(lookahead);
-                        }
-                        continue;
-                    }
-                    new_lookaheads.insert(letter);
-                }
-            } else {
-                for (auto lookahead: item.lookaheads) {
-                    new_lookaheads.insert(lookahead);
-                }
-            }
-
-            for (auto &rule: production_rules[after_dot[0]]) {
-                Item new_item(after_dot[0], rule, 0, new_lookaheads);
-                if (!ItemIsInSet(new_item, new_items_set)) {
-                    new_items_set.push_back(new_item);
-                }
-            }
-        }
-    }
-    return new_items_set;
-}
-
-std::vector<Item> Algo::Transition(State &state, char symbol) {
-    std::vector<Item> new_items;
-    for (auto &item: state.items) {
-        auto dot_pos = item.rhs.find('.');
-        if (dot_pos == item.rhs.size() - 1) {
-            continue;
-        }
-        auto after_dot = item.rhs.substr(dot_pos + 1);
-        if (after_dot[0] == symbol) {
-            auto new_rhs = item.rhs;
-            std::swap(new_rhs[dot_pos], new_rhs[dot_pos + 1]);
-            new_items.emplace_back(item.lhs, new_rhs, item.lookaheads);
-        }
-    }
-    return Closure(new_items);
-}
-
-int Algo::StateAlreadyExists(std::vector<Item> &curr_state) {
-    std::sort(curr_state.begin(), curr_state.end());
-    for (auto &state: states) {
-        if (curr_state.size() != state.items.size()) {
-            continue;
-        }
-        std::sort(state.items.begin(), state.items.end());
-        bool there_is_not_equal_item = false;
-        for (size_t i = 0; i < curr_state.size(); ++i) {
-            if (curr_state[i] != state.items[i]) {
-                there_is_not_equal_item = true;
-            }
-        }
-        if (!there_is_not_equal_item) {
-            return state.personal_id;
-        }
-    }
-    return -1;
-}
-
-void Algo::CalculateStates() {
-    auto start_rule = production_rules[kRealStart][0];
-    std::vector<Item> zero_state_set;
-    zero_state_set.push_back(Item(kRealStart, start_rule, 0, {kEndOfLine}));
-    states.emplace_back(Closure(zero_state_set));
-    if (states.back().items.size() == 1) {
-        throw GrammarException("The grammar is incorrect. There are no reachable symbols.");
-    }
-    for (size_t i = 0; i < states.size(); ++i) {
-        for (auto &terminal: terminals) {
-            if (terminal == kEpsilon) {
-                continue;
-            }
-            auto new_state = Transition(states[i], terminal);
-            if (!new_state.empty()) {
-                auto state_id = StateAlreadyExists(new_state);
-                if (state_id == -1) {
-                    states.emplace_back(new_state);
-                    states[i].transitions[terminal] = states[states.size() - 1].personal_id;
-                } else {
-                    states[i].transitions[terminal] = state_id;
-                }
-            }
-        }
-
-        for (auto &nonterminal: nonterminals) {
-            if (nonterminal.first == kRealStart) {
-                continue;
-            }
-            auto new_state = Transition(states[i], nonterminal.first);
-            if (!new_state.empty()) {
-                auto state_id = StateAlreadyExists(new_state);
-                if (state_id == -1) {
-                    states.emplace_back(new_state);
-                    states[i].transitions[nonterminal.first] = states[states.size() - 1].personal_id;
-                } else {
-                    states[i].transitions[nonterminal.first] = state_id;
-                }
-
-                if (states[states.size() - 1].items[0].lhs == kRealStart) {
-                    accept_state_id = states[states.size() - 1].personal_id;
-                }
-
-            }
-        }
-    }
-}
-
-void Algo::MakeTable() {
-    table = TableType(states.size());
-    for (size_t i = 0; i < table.size(); ++i) {
-        for (auto &transition: states[i].transitions) {
-            if (table[i].contains(transition.first)) {
-                throw GrammarException("Shift/Reduce conflict occurred. The grammar is no LR(1) type.");
-            }
-            table[i][transition.first] = std::to_string(transition.second);
-        }
-        for (auto &item: states[i].items) {
-            if (item.rhs[item.rhs.size() - 1] == '.' || item.rhs[item.rhs.size() - 1] == kEpsilon) {
-                for (auto lookahead: item.lookaheads) {
-                    if (table[i].contains(lookahead)) {
-                        std::string error;
-                        if (std::isdigit(table[i][lookahead][0])) {
-                            error = "Shift/Reduce conflict occurred. The grammar is no LR(1) type.";
-                        } else {
-                            error = "Reduce/Reduce conflict occurred. The grammar is no LR(1) type.";
-                        }
-                        throw GrammarException(error);
-                    }
-                    auto rule_without_dot = item.rhs;
-                    auto dot_pos = rule_without_dot.find('.');
-                    rule_without_dot.erase(dot_pos);
-                    table[i][lookahead] = std::string{item.lhs} + "->" + rule_without_dot;
-                }
-            }
-        }
-    }
-}
-
-bool Algo::Predict(std::string input, std::vector<std::string> &derivation_rules) {
-    input += kEndOfLine;
-    if (input[0] == kEpsilon && input[1] == kEndOfLine) {
-        input = input.substr(1);
-    }
-    std::stack<ParseType> parse_stack;
-    std::string delimiter = "->";
-    parse_stack.push({true, "0"});
-    for (size_t i = 0; i < input.size(); ++i) {
-        if (!terminals.contains(input[i]) && input[i] != kEndOfLine) {
-            return false;
-        }
-        auto action = table[std::stoi(parse_stack.top().value)].find(input[i]);
-        if (action != table[std::stoi(parse_stack.top().value)].end()) {
-            if (std::isdigit(action->second[0])) {
-                parse_stack.push({false, std::string{input[i]}});
-                parse_stack.push({true, action->second});
-            } else {
-                if (!table[std::stoi(parse_stack.top().value)].contains(input[i])) {
-                    return false;
-                }
-                while (!std::isdigit(action->second[0])) {
-                    derivation_rules.push_back(action->second);
-                    auto delimiter_pos = action->second.find(delimiter);
-                    auto lhs_part = action->second.substr(0, delimiter_pos)[0];
-                    auto rhs_part = action->second.substr(delimiter_pos + 2);
-                    for (int j = rhs_part.size() - 1; j >= 0; --j) {
-                        while (!parse_stack.empty() && !(parse_stack.top().value == std::string{rhs_part[j]} &&
-                                                         !parse_stack.top().is_shift)) {
-                            parse_stack.pop();
-                        }
-                        if (parse_stack.empty()) {
-                            return false;
-                        }
-                        parse_stack.pop();
-                    }
-
-                    if (lhs_part == kRealStart && i == input.size() - 1) {
-                        return true;
-                    }
-
-                    int last_number = std::stoi(parse_stack.top().value);
-                    parse_stack.push({false, std::string{lhs_part}});
-                    action = table[last_number].find(lhs_part);
-
-                    if (action != table[last_number].end()) {
-                        parse_stack.push({true, action->second});
-                    } else {
-                        return false;
-                    }
-
-                    action = table[std::stoi(parse_stack.top().value)].find(input[i]);
-                    if (action == table[std::stoi(parse_stack.top().value)].end()) {
-                        return false;
-                    }
-
-                }
-                parse_stack.push({false, std::string{action->first}});
-                parse_stack.push({true, action->second});
-            }
-        } else {
-            return false;
-        }
-    }
-    return false;
-}
-
-// function CalculateDerivation
-
-std::string CalculateDerivation(const std::vector<std::string> &derivation_rules) {
-    std::string derivation = std::string{kRealStart};
-    std::string delimiter = "->";
-    derivation += delimiter + derivation_rules[derivation_rules.size() - 1][3];
-    for (int i = derivation_rules.size() - 2; i >= 0; --i) {
-        auto delimiter_pos = derivation.rfind(delimiter);
-        auto rule_to_replace = derivation.substr(delimiter_pos + 2);
-        auto nonterm_to_replace = rule_to_replace.rfind(derivation_rules[i][0]);
-        auto part_after_nonterm = rule_to_replace.substr(nonterm_to_replace + 1);
-        rule_to_replace = rule_to_replace.substr(0, nonterm_to_replace);
-        delimiter_pos = derivation_rules[i].find(delimiter);
-        auto expansion = derivation_rules[i].substr(delimiter_pos + 2);
-        rule_to_replace += (expansion + part_after_nonterm);
-        derivation += delimiter + rule_to_replace;
-    }
-    return derivation;
-}
-
-void PrintStates(const Algo &parser) {
-    std::cout << "Automaton states:" << '\n';
-    for (const auto &state: parser.states) {
-        if (state.personal_id == parser.accept_state_id) {
-            std::cout << "Accept state " << state.personal_id << '\n';
-        } else {
-            std::cout << "State " << state.personal_id << '\n';
-        }
-        for (auto &item: state.items) {
-            std::cout << "(" << item.lhs << "->" << item.rhs << "|";
-            for (auto symbol = item.lookaheads.begin(); symbol != item.lookaheads.end(); ++symbol) {
-                if (std::next(symbol) == item.lookaheads.end()) {
-                    std::cout << *symbol;
-                    break;
-                }
-                std::cout << *symbol << ", ";
-            }
-            std::cout << ")" << '\n';
-        }
-        std::cout << '\n';
-        for (auto j: state.transitions) {
-            if (parser.terminals.contains(j.first)) {
-                std::cout << "By terminal " << j.first << " shift to state " << j.second << '\n';
-            } else {
-                std::cout << "By nonterminal " << j.first << " go to state " << j.second << '\n';
-            }
-        }
-        std::cout << '\n';
-    }
-}
-
-void PrintTable(Algo &parser) {
-    std::cout << std::setw(25) << std::left << "States/Symbols";
-
-    for (const auto terminal: parser.terminals) {
-        if (terminal == kEpsilon) {
-            continue;
-        }
-        std::cout << std::setw(15) << std::left << terminal;
-    }
-
-    std::cout << std::setw(15) << std::left << kEndOfLine;
-
-    for (const auto &nonterminal: parser.nonterminals) {
-        if (nonterminal.first == kRealStart) {
-            continue;
-        }
-        std::cout << std::setw(15) << std::left << nonterminal.first;
-    }
-    std::cout << '\n';
-
-    for (size_t i = 0; i < parser.table.size(); ++i) {
-        std::cout << "State " << std::setw(19) << std::left << i;
-        for (const auto terminal: parser.terminals) {
-            if (terminal == kEpsilon) {
-                continue;
-            }
-            std::cout << std::setw(15) << std::left
-                      << (parser.table[i].contains(terminal) ? parser.table[i][terminal] : " ");
-        }
-
-        std::cout << std::setw(15) << std::left
-                  << (parser.table[i].contains(kEndOfLine) ? parser.table[i][kEndOfLine] : " ");
-
-        for (const auto &nonterminal: parser.nonterminals) {
-            if (nonterminal.first == kRealStart) {
-                continue;
-            }
-            std::cout << std::setw(15) << std::left
-                      << (parser.table[i].contains(nonterminal.first) ? parser.table[i][nonterminal.first] : " ");
-        }
-        std::cout << '\n';
-    }
-    std::cout << '\n';
-}
-
-
+
+#include "CLR1_parser.h"
+#include <fstream>
+#include <cstring>
+#include <numeric>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// class Item
+Item::Item(int production_id,
+           int dot_pos,
+           const SymbolSet &new_lookaheads) :
+        production(production_id),
+        dot(dot_pos),
+        lookaheads(new_lookaheads) {
+}
+
+bool Item::operator==(const Item &second) const {
+    if (production != second.production) {
+        return false;
+    }
+    if (dot != second.dot) {
+        return false;
+    }
+    if (lookaheads != second.lookaheads) {
+        return false;
+    }
+    return true;
+}
+
+bool Item::operator<(const Item &second) const {
+    if (production < second.production) {
+        return true;
+    }
+    if (production == second.production) {
+        if (dot < second.dot) {
+            return true;
+        }
+        if (dot == second.dot) {
+            if (lookaheads < second.lookaheads) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool Item::operator!=(const Item &second) const {
+    return !operator==(second);
+}
+
+// class Production
+
+Production::Production(char rule_lhs, const std::string &rule_rhs) :
+        lhs(rule_lhs),
+        rhs(rule_rhs),
+        rule(std::string{rule_lhs} + "->") {
+    for (auto symbol: rhs) {
+        if (symbol != kEpsilon) {
+            symbols += symbol;
+        }
+    }
+    length = symbols.size();
+    rule += symbols;
+}
+
+// class ParseContext
+
+ParseContext::ParseContext(size_t stack_capacity) {
+    stack.reserve(stack_capacity);
+    reductions.reserve(stack_capacity);
+}
+
+// class ParseTable
+
+ParseTable::ParseTable() {
+    column.fill(kNoColumn);
+}
+
+ParseTable::ParseTable(size_t states_number,
+                       const std::set<char> &terminals,
+                       const std::vector<char> &nonterminals) : ParseTable() {
+    for (auto terminal: terminals) {
+        if (terminal == kEpsilon) {
+            continue;
+        }
+        column[static_cast<unsigned char>(terminal)] = static_cast<int>(terminal_count++);
+    }
+    column[static_cast<unsigned char>(kEndOfLine)] = static_cast<int>(terminal_count++);
+    for (auto nonterminal: nonterminals) {
+        column[static_cast<unsigned char>(nonterminal)] = static_cast<int>(nonterminal_count++);
+    }
+    state_count = states_number;
+    actions.assign(state_count * terminal_count, MakeAction(ActionType::kError));
+    gotos.assign(state_count * nonterminal_count, kNoState);
+}
+
+TableView ParseTable::View() const {
+    TableView view;
+    view.column = column.data();
+    view.state_count = state_count;
+    view.terminal_count = terminal_count;
+    view.nonterminal_count = nonterminal_count;
+    view.actions = actions.data();
+    view.gotos = gotos.data();
+    view.production_lengths = production_lengths.data();
+    view.production_lhs = production_lhs.data();
+    return view;
+}
+
+// class CompressedTable
+
+// First-fit comb vector packing, rows with the most entries first. Every row gets the smallest base at which all
+// of its entries land on free slots; the arrays are sized so that base + column is always a valid slot.
+template<typename Cell>
+static std::vector<int> PackRows(const std::vector<std::vector<std::pair<int, Cell>>> &rows, size_t width,
+                                 std::vector<Cell> &packed, std::vector<int> &check) {
+    std::vector<size_t> order(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&rows](size_t first, size_t second) {
+        return rows[first].size() > rows[second].size();
+    });
+    std::vector<int> base(rows.size(), 0);
+    std::vector<bool> used;
+    size_t slots_number = width;
+    for (auto row: order) {
+        if (rows[row].empty()) {
+            continue;
+        }
+        size_t candidate = 0;
+        auto fits = [&]() {
+            for (auto &entry: rows[row]) {
+                auto slot = candidate + entry.first;
+                if (slot < used.size() && used[slot]) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        while (!fits()) {
+            ++candidate;
+        }
+        base[row] = static_cast<int>(candidate);
+        for (auto &entry: rows[row]) {
+            auto slot = candidate + entry.first;
+            if (slot >= used.size()) {
+                used.resize(slot + 1, false);
+                packed.resize(slot + 1);
+                check.resize(slot + 1, kNoState);
+            }
+            used[slot] = true;
+            packed[slot] = entry.second;
+            check[slot] = static_cast<int>(row);
+        }
+        slots_number = std::max(slots_number, candidate + width);
+    }
+    packed.resize(slots_number);
+    check.resize(slots_number, kNoState);
+    return base;
+}
+
+CompressedTable::CompressedTable(const TableView &table_view, size_t production_count) :
+        state_count(table_view.state_count),
+        terminal_count(table_view.terminal_count),
+        nonterminal_count(table_view.nonterminal_count),
+        default_actions(state_count, ParseTable::MakeAction(ActionType::kError)),
+        error_bits((state_count * terminal_count + 63) / 64, 0),
+        production_lengths(table_view.production_lengths, table_view.production_lengths + production_count),
+        production_lhs(table_view.production_lhs, table_view.production_lhs + production_count) {
+    std::copy(table_view.column, table_view.column + column.size(), column.begin());
+    std::vector<std::vector<std::pair<int, ActionCell>>> action_rows(state_count);
+    std::vector<std::vector<std::pair<int, int>>> goto_rows(state_count);
+    for (size_t i = 0; i < state_count; ++i) {
+        auto state = static_cast<int>(i);
+        std::map<ActionCell, size_t> reduce_counts;
+        for (size_t j = 0; j < terminal_count; ++j) {
+            auto cell = table_view.Action(state, static_cast<int>(j));
+            if (ParseTable::TypeOf(cell) == ActionType::kReduce) {
+                ++reduce_counts[cell];
+            }
+        }
+        size_t best_count = 0;
+        for (auto &[cell, count]: reduce_counts) {
+            if (count > best_count) {
+                best_count = count;
+                default_actions[i] = cell;
+            }
+        }
+        for (size_t j = 0; j < terminal_count; ++j) {
+            auto cell = table_view.Action(state, static_cast<int>(j));
+            if (ParseTable::TypeOf(cell) == ActionType::kError) {
+                auto bit = i * terminal_count + j;
+                error_bits[bit / 64] |= std::uint64_t{1} << (bit % 64);
+            } else if (cell != default_actions[i]) {
+                action_rows[i].emplace_back(static_cast<int>(j), cell);
+            }
+        }
+        for (size_t j = 0; j < nonterminal_count; ++j) {
+            auto next_state = table_view.Goto(state, static_cast<int>(j));
+            if (next_state != kNoState) {
+                goto_rows[i].emplace_back(static_cast<int>(j), next_state);
+            }
+        }
+    }
+    action_base = PackRows(action_rows, terminal_count, packed_actions, action_check);
+    goto_base = PackRows(goto_rows, nonterminal_count, packed_gotos, goto_check);
+}
+
+size_t CompressedTable::RawBytes() const {
+    return state_count * (terminal_count * sizeof(ActionCell) + nonterminal_count * sizeof(int));
+}
+
+size_t CompressedTable::Bytes() const {
+    return default_actions.size() * sizeof(ActionCell) + action_base.size() * sizeof(int) +
+           packed_actions.size() * sizeof(ActionCell) + action_check.size() * sizeof(int) +
+           goto_base.size() * sizeof(int) + packed_gotos.size() * sizeof(int) + goto_check.size() * sizeof(int) +
+           error_bits.size() * sizeof(std::uint64_t);
+}
+
+// class MappedFile
+
+MappedFile::MappedFile(const std::string &path) {
+    auto descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor == -1) {
+        throw TableFileException("Cannot open the file " + path + ".");
+    }
+    struct stat file_stat{};
+    if (fstat(descriptor, &file_stat) == -1 || file_stat.st_size == 0) {
+        close(descriptor);
+        throw TableFileException("Cannot read the file " + path + ".");
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    auto mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED) {
+        throw TableFileException("Cannot map the file " + path + ".");
+    }
+    data_ = static_cast<const char *>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char *>(data_), size_);
+}
+
+// class State
+
+State::State(const std::vector<Item> &new_items, int id) : personal_id(id), items(new_items) {
+    std::sort(items.begin(), items.end());
+}
+
+std::vector<Item> State::Kernel(const std::vector<Item> &closure_items) {
+    std::vector<Item> kernel;
+    for (auto &item: closure_items) {
+        // Closure only adds items with the dot at the beginning, and never for the real start rule.
+        if (item.dot != 0 || item.production == 0) {
+            kernel.push_back(item);
+        }
+    }
+    return kernel;
+}
+
+std::string State::Fingerprint(const std::vector<Item> &canonical_items) {
+    std::string fingerprint;
+    for (auto &item: canonical_items) {
+        fingerprint.append(reinterpret_cast<const char *>(&item.production), sizeof(item.production));
+        fingerprint.append(reinterpret_cast<const char *>(&item.dot), sizeof(item.dot));
+        fingerprint.append(reinterpret_cast<const char *>(item.lookaheads.words.data()),
+                           sizeof(item.lookaheads.words));
+    }
+    return fingerprint;
+}
+
+// class Algo
+
+// Splits a rule "A->rhs" into its left and right parts.
+static std::pair<char, std::string> SplitRule(const std::string &rule) {
+    std::string delimiter = "->";
+    auto delimiter_pos = rule.find(delimiter);
+    auto lhs_part_substr = rule.substr(0, delimiter_pos);
+    if (lhs_part_substr.size() != 1 || !std::isupper(lhs_part_substr[0])) {
+        throw GrammarException("The grammar contains incorrect LHS part.");
+    }
+    return {lhs_part_substr[0], rule.substr(delimiter_pos + delimiter.size())};
+}
+
+Algo::Algo(std::vector<std::string> &grammar, const BuildOptions &build_options) {
+    Fit(grammar, build_options);
+}
+
+template<typename T>
+static T ReadLittleEndian(const char *bytes) {
+    std::make_unsigned_t<T> value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<std::make_unsigned_t<T>>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return static_cast<T>(value);
+}
+
+template<typename T>
+static void WriteLittleEndian(std::ostream &out, const T *values, size_t count) {
+    if constexpr (std::endian::native == std::endian::little) {
+        out.write(reinterpret_cast<const char *>(values), static_cast<std::streamsize>(count * sizeof(T)));
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            auto value = static_cast<std::make_unsigned_t<T>>(values[i]);
+            char bytes[sizeof(T)];
+            for (size_t j = 0; j < sizeof(T); ++j) {
+                bytes[j] = static_cast<char>((value >> (8 * j)) & 0xff);
+            }
+            out.write(bytes, sizeof(T));
+        }
+    }
+}
+
+template<typename T>
+static void WriteLittleEndian(std::ostream &out, T value) {
+    WriteLittleEndian(out, &value, 1);
+}
+
+template<typename T>
+static std::vector<T> ReadLittleEndianArray(const char *bytes, size_t count) {
+    std::vector<T> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = ReadLittleEndian<T>(bytes + i * sizeof(T));
+    }
+    return values;
+}
+
+// Checks every cell of a mapped table once, so the drivers can index with its values unchecked.
+static void ValidateTableFile(const Algo &parser, const TableView &view) {
+    auto fail = [](const std::string &what) {
+        throw TableFileException("The parse table file holds an invalid " + what + ".");
+    };
+    auto production_count = parser.productions.size();
+    if (view.state_count == 0) {
+        fail("state count");
+    }
+    for (size_t symbol = 0; symbol < 256; ++symbol) {
+        auto symbol_column = view.column[symbol];
+        auto is_nonterminal = parser.nonterminals.contains(static_cast<char>(symbol));
+        auto limit = is_nonterminal ? view.nonterminal_count : view.terminal_count;
+        if (symbol_column != kNoColumn && (symbol_column < 0 || static_cast<size_t>(symbol_column) >= limit)) {
+            fail("symbol column");
+        }
+    }
+    for (size_t i = 0; i < production_count; ++i) {
+        if (view.production_lengths[i] != parser.productions[i].length) {
+            fail("production length");
+        }
+        auto lhs = view.production_lhs[i];
+        // The augmented start production is never reduced, so its left side has no goto column.
+        if (i == 0 ? lhs != kNoColumn : lhs < 0 || static_cast<size_t>(lhs) >= view.nonterminal_count) {
+            fail("production left side");
+        }
+    }
+    for (size_t i = 0; i < view.state_count * view.terminal_count; ++i) {
+        auto action = view.actions[i];
+        auto value = static_cast<size_t>(ParseTable::ValueOf(action));
+        switch (ParseTable::TypeOf(action)) {
+            case ActionType::kError:
+            case ActionType::kAccept:
+                break;
+            case ActionType::kShift:
+                if (value >= view.state_count) {
+                    fail("shift target");
+                }
+                break;
+            case ActionType::kReduce:
+                if (value == 0 || value >= production_count) {
+                    fail("reduced production");
+                }
+                break;
+            default:
+                // Conflict lists are never saved, so a conflict cell has nothing to point at.
+                fail("action type");
+        }
+    }
+    for (size_t i = 0; i < view.state_count * view.nonterminal_count; ++i) {
+        auto target = view.gotos[i];
+        if (target != kNoState && (target < 0 || static_cast<size_t>(target) >= view.state_count)) {
+            fail("goto target");
+        }
+    }
+    if (parser.accept_state_id != kNoState &&
+        (parser.accept_state_id < 0 || static_cast<size_t>(parser.accept_state_id) >= view.state_count)) {
+        fail("accept state");
+    }
+}
+
+Algo::Algo(const std::string &table_path, std::vector<std::string> &grammar) {
+    static_assert(sizeof(int) == sizeof(std::int32_t));
+    ProcessInputGrammar(grammar);
+    table_file = std::make_shared<MappedFile>(table_path);
+    auto data = table_file->data();
+
+    TableFileHeader header{};
+    if (table_file->size() < sizeof(TableFileHeader) || std::memcmp(data, kTableFileMagic, 8) != 0) {
+        throw TableFileException("The file is not a parse table file.");
+    }
+    auto field = data + sizeof(header.magic);
+    auto read_field = [&field](auto &value) {
+        value = ReadLittleEndian<std::remove_reference_t<decltype(value)>>(field);
+        field += sizeof(value);
+    };
+    read_field(header.version);
+    read_field(header.state_count);
+    read_field(header.terminal_count);
+    read_field(header.nonterminal_count);
+    read_field(header.production_count);
+    read_field(header.accept_state);
+    read_field(header.grammar_hash);
+    read_field(header.columns_offset);
+    read_field(header.actions_offset);
+    read_field(header.gotos_offset);
+    read_field(header.lengths_offset);
+    read_field(header.lhs_offset);
+    read_field(header.file_size);
+    if (header.version != kTableFileVersion) {
+        throw TableFileException("The parse table file has an unsupported version.");
+    }
+    std::pair<std::uint64_t, std::uint64_t> sections[] = {
+            {header.columns_offset, 256 * sizeof(std::int32_t)},
+            {header.actions_offset,
+             std::uint64_t{header.state_count} * header.terminal_count * sizeof(std::uint32_t)},
+            {header.gotos_offset,
+             std::uint64_t{header.state_count} * header.nonterminal_count * sizeof(std::int32_t)},
+            {header.lengths_offset, std::uint64_t{header.production_count} * sizeof(std::uint32_t)},
+            {header.lhs_offset, std::uint64_t{header.production_count} * sizeof(std::int32_t)}};
+    for (auto &[offset, size]: sections) {
+        if (header.file_size != table_file->size() || offset % 8 != 0 || offset > header.file_size ||
+            size > header.file_size - offset) {
+            throw TableFileException("The parse table file is truncated.");
+        }
+    }
+    if (header.grammar_hash != GrammarHash() || header.production_count != productions.size()) {
+        throw GrammarException("The parse table file was built for another grammar.");
+    }
+    accept_state_id = header.accept_state;
+
+    if constexpr (std::endian::native == std::endian::little) {
+        table_file_view.column = reinterpret_cast<const int *>(data + header.columns_offset);
+        table_file_view.state_count = header.state_count;
+        table_file_view.terminal_count = header.terminal_count;
+        table_file_view.nonterminal_count = header.nonterminal_count;
+        table_file_view.actions = reinterpret_cast<const std::uint32_t *>(data + header.actions_offset);
+        table_file_view.gotos = reinterpret_cast<const int *>(data + header.gotos_offset);
+        table_file_view.production_lengths = reinterpret_cast<const std::uint32_t *>(data + header.lengths_offset);
+        table_file_view.production_lhs = reinterpret_cast<const int *>(data + header.lhs_offset);
+    } else {
+        auto columns = ReadLittleEndianArray<int>(data + header.columns_offset, table.column.size());
+        std::copy(columns.begin(), columns.end(), table.column.begin());
+        table.state_count = header.state_count;
+        table.terminal_count = header.terminal_count;
+        table.nonterminal_count = header.nonterminal_count;
+        table.actions = ReadLittleEndianArray<std::uint32_t>(data + header.actions_offset,
+                                                             table.state_count * table.terminal_count);
+        table.gotos = ReadLittleEndianArray<int>(data + header.gotos_offset,
+                                                 table.state_count * table.nonterminal_count);
+        table.production_lengths = ReadLittleEndianArray<std::uint32_t>(data + header.lengths_offset,
+                                                                        header.production_count);
+        table.production_lhs = ReadLittleEndianArray<int>(data + header.lhs_offset, header.production_count);
+        table_file.reset();
+    }
+    ValidateTableFile(*this, View());
+}
+
+void Algo::Fit(std::vector<std::string> &grammar, const BuildOptions &build_options) {
+    options = build_options;
+    ProcessInputGrammar(grammar);
+    CalculateFirstSets();
+    BuildAutomaton();
+}
+
+void Algo::BuildAutomaton(const KernelClosureCacheType *reusable_closures) {
+    if (options.mode == ConstructionMode::kLazy) {
+        if (options.glr) {
+            throw std::invalid_argument("The GLR driver needs the complete table, which lazy construction never has.");
+        }
+        if (options.compress_table) {
+            throw std::invalid_argument("Only a complete table can be compressed, which lazy construction never has.");
+        }
+        lazy_table = std::make_shared<const LazyTable>(*this);
+        return;
+    }
+    CalculateStates(reusable_closures);
+    construction_stats.canonical_states = states.size();
+    if (options.mode == ConstructionMode::kMinimal) {
+        MergeStates();
+    }
+    construction_stats.merged_states = states.size();
+    MakeTable();
+    if (options.compress_table) {
+        compressed_table = std::make_shared<const CompressedTable>(table.View(), productions.size());
+    }
+}
+
+// Edits run on a copy of the parser that replaces it only once the new automaton and table are built, so an edit
+// that throws leaves the parser as it was.
+void Algo::AddProduction(const std::string &rule) {
+    auto [lhs, rhs] = SplitRule(rule);
+    std::vector<int> new_id(productions.size());
+    std::iota(new_id.begin(), new_id.end(), 0);
+    auto edited = *this;
+    edited.production_rules[lhs].push_back(rhs);
+    edited.productions.emplace_back(lhs, rhs);
+    edited.ApplyGrammarEdit(lhs, new_id, false);
+    *this = std::move(edited);
+}
+
+// Removes the first production written as `rule`; later productions move down by one.
+void Algo::RemoveProduction(const std::string &rule) {
+    auto [lhs, rhs] = SplitRule(rule);
+    auto removed = std::find_if(productions.begin() + 1, productions.end(), [lhs, &rhs](const Production &production) {
+        return production.lhs == lhs && production.rhs == rhs;
+    });
+    if (removed == productions.end()) {
+        throw GrammarException("The grammar has no production " + rule + ".");
+    }
+    auto removed_id = static_cast<int>(removed - productions.begin());
+    std::vector<int> new_id(productions.size());
+    for (size_t i = 0; i < productions.size(); ++i) {
+        auto id = static_cast<int>(i);
+        new_id[i] = id < removed_id ? id : (id == removed_id ? -1 : id - 1);
+    }
+    auto edited = *this;
+    auto &rules = edited.production_rules[lhs];
+    rules.erase(std::find(rules.begin(), rules.end(), rhs));
+    if (rules.empty()) {
+        edited.production_rules.erase(lhs);
+    }
+    edited.productions.erase(edited.productions.begin() + removed_id);
+    edited.ApplyGrammarEdit(lhs, new_id, true);
+    *this = std::move(edited);
+}
+
+// Brings FIRST sets, automaton and table in line with the edited productions; new_id maps the old production ids.
+// Only FIRST sets that depend on `lhs` are recomputed. Closures that cannot have changed are carried over with
+// renumbered items and the automaton is rebuilt around them in the order a fresh build discovers the states.
+void Algo::ApplyGrammarEdit(char lhs, const std::vector<int> &new_id, bool removed) {
+    if (table_file) {
+        throw std::logic_error("A parser loaded from a table file cannot be edited.");
+    }
+    std::map<char, SymbolSet> old_first;
+    for (auto &nonterminal: nonterminals) {
+        old_first[nonterminal.first] = nonterminal.second.first;
+    }
+    NumberProductions();
+    CollectSymbols();
+
+    std::vector<int> dirty_productions;
+    if (removed) {
+        // Clear the FIRST sets of lhs and of every nonterminal that can derive a string through it.
+        SymbolSet depends_on_lhs{lhs};
+        for (bool grew = true; grew;) {
+            grew = false;
+            for (size_t i = 1; i < productions.size(); ++i) {
+                auto &production = productions[i];
+                if (depends_on_lhs.contains(production.lhs)) {
+                    continue;
+                }
+                if (std::any_of(production.symbols.begin(), production.symbols.end(), [&](char symbol) {
+                    return depends_on_lhs.contains(symbol);
+                })) {
+                    depends_on_lhs.insert(production.lhs);
+                    grew = true;
+                }
+            }
+        }
+        for (auto &nonterminal: nonterminals) {
+            if (depends_on_lhs.contains(nonterminal.first)) {
+                nonterminal.second.first = SymbolSet();
+            }
+        }
+        for (size_t i = 1; i < productions.size(); ++i) {
+            if (depends_on_lhs.contains(productions[i].lhs)) {
+                dirty_productions.push_back(static_cast<int>(i));
+            }
+        }
+    } else {
+        dirty_productions.push_back(static_cast<int>(productions.size()) - 1);
+    }
+    UpdateFirstSets(dirty_productions);
+
+    SymbolSet changed_first;
+    for (auto &nonterminal: nonterminals) {
+        auto previous = old_first.find(nonterminal.first);
+        if (previous == old_first.end() || previous->second != nonterminal.second.first) {
+            changed_first.insert(nonterminal.first);
+        }
+    }
+    // Closure items are the productions of the symbols after the dots, with lookaheads taken from the FIRST sets
+    // of what follows those symbols. Items of lhs and items followed by a changed FIRST set are all that can
+    // differ; symbols before the dot play no part.
+    auto is_stale = [&](const Item &item) {
+        if (item.production < 0 || productions[item.production].lhs == lhs) {
+            return true;
+        }
+        auto &symbols = productions[item.production].symbols;
+        return std::any_of(symbols.begin() + std::min<size_t>(item.dot + 1, symbols.size()), symbols.end(),
+                           [&changed_first](char symbol) {
+                               return changed_first.contains(symbol);
+                           });
+    };
+    KernelClosureCacheType reusable_closures;
+    for (auto &state: states) {
+        auto items = std::move(state.items);
+        for (auto &item: items) {
+            item.production = new_id[item.production];
+        }
+        if (std::none_of(items.begin(), items.end(), is_stale)) {
+            reusable_closures.emplace(State::Fingerprint(State::Kernel(items)), std::move(items));
+        }
+    }
+
+    states.clear();
+    state_index.clear();
+    core_closures.clear();
+    construction_stats = ConstructionStats();
+    accept_state_id = kNoState;
+    compressed_table.reset();
+    lazy_table.reset();
+    BuildAutomaton(&reusable_closures);
+}
+
+void Algo::ProcessInputGrammar(std::vector<std::string> &grammar) {
+    for (auto &rule: grammar) {
+        if (rule.size() == 1) {
+            break;
+        }
+        if (rule[0] == kDeclarationPrefix) {
+            DeclarePrecedence(rule);
+            continue;
+        }
+        auto [lhs_part, rhs_part] = SplitRule(rule);
+        production_rules[lhs_part].push_back(rhs_part);
+    }
+    production_rules[kRealStart].push_back(grammar[grammar.size() - 1]);
+
+    productions.emplace_back(kRealStart, production_rules[kRealStart][0]);
+    for (auto &rule: grammar) {
+        if (rule.size() == 1) {
+            break;
+        }
+        if (rule[0] == kDeclarationPrefix) {
+            continue;
+        }
+        auto [lhs_part, rhs_part] = SplitRule(rule);
+        productions.emplace_back(lhs_part, rhs_part);
+    }
+    NumberProductions();
+    CollectSymbols();
+}
+
+// Every declaration line opens a new precedence level above the previous ones.
+void Algo::DeclarePrecedence(const std::string &declaration) {
+    static const std::pair<std::string_view, Associativity> kKeywords[] = {
+            {"%left", Associativity::kLeft}, {"%right", Associativity::kRight}, {"%nonassoc", Associativity::kNonAssoc}};
+    auto keyword = std::find_if(std::begin(kKeywords), std::end(kKeywords), [&declaration](const auto &entry) {
+        return declaration.starts_with(entry.first);
+    });
+    if (keyword == std::end(kKeywords)) {
+        throw GrammarException("Unknown grammar declaration.");
+    }
+    auto operators = std::string_view(declaration).substr(keyword->first.size());
+    if (operators.empty()) {
+        throw GrammarException("The precedence declaration lists no terminals.");
+    }
+    auto level = 1;
+    for (auto &entry: precedence) {
+        level = std::max(level, entry.second.level + 1);
+    }
+    for (auto symbol: operators) {
+        if ((symbol >= kNonTerminalAlphabetBeg && symbol <= kNonTerminalAlphabetEnd) || symbol == kEpsilon ||
+            symbol == kEndOfLine || symbol == kRealStart) {
+            throw GrammarException("Only terminals can have a precedence.");
+        }
+        if (!precedence.try_emplace(symbol, OperatorPrecedence{level, keyword->second}).second) {
+            throw GrammarException("The precedence of a terminal is declared twice.");
+        }
+    }
+}
+
+void Algo::NumberProductions() {
+    core_count = 0;
+    productions_of.clear();
+    for (size_t i = 0; i < productions.size(); ++i) {
+        productions[i].core_offset = core_count;
+        core_count += productions[i].length + 1;
+        productions_of[productions[i].lhs].push_back(static_cast<int>(i));
+    }
+}
+
+// Rebuilds the terminal and nonterminal sets from the user productions. FIRST sets of kept nonterminals survive.
+void Algo::CollectSymbols() {
+    NonTerminalSetType collected_nonterminals;
+    terminals.clear();
+    for (size_t i = 1; i < productions.size(); ++i) {
+        collected_nonterminals.try_emplace(productions[i].lhs, productions[i].lhs);
+        for (auto symbol: productions[i].rhs) {
+            if (symbol >= kNonTerminalAlphabetBeg && symbol <= kNonTerminalAlphabetEnd) {
+                collected_nonterminals.try_emplace(symbol, symbol);
+            } else {
+                terminals.insert(symbol);
+            }
+        }
+    }
+    collected_nonterminals.try_emplace(kRealStart, kRealStart);
+    for (auto &[symbol, nonterminal]: collected_nonterminals) {
+        if (auto previous = nonterminals.find(symbol); previous != nonterminals.end()) {
+            nonterminal.first = previous->second.first;
+        }
+    }
+    nonterminals = std::move(collected_nonterminals);
+}
+
+void Algo::CalculateFirstSets() {
+    std::vector<int> all_productions;
+    for (auto &nonterminal: nonterminals) {
+        nonterminal.second.first = SymbolSet();
+    }
+    for (size_t i = 1; i < productions.size(); ++i) {
+        all_productions.push_back(static_cast<int>(i));
+    }
+    UpdateFirstSets(all_productions);
+}
+
+// Continues the FIRST fixed point from the current sets, starting with the given productions. Sets may only
+// grow, so nonterminals that can lose symbols must be cleared by the caller first.
+void Algo::UpdateFirstSets(const std::vector<int> &dirty_productions) {
+    std::array<bool, 256> is_nonterminal{};
+    std::array<SymbolSet, 256> first;
+    std::array<std::vector<int>, 256> productions_using;
+    for (auto &nonterminal: nonterminals) {
+        is_nonterminal[static_cast<unsigned char>(nonterminal.first)] = true;
+        first[static_cast<unsigned char>(nonterminal.first)] = nonterminal.second.first;
+    }
+    for (size_t i = 0; i < productions.size(); ++i) {
+        for (auto symbol: productions[i].symbols) {
+            auto &users = productions_using[static_cast<unsigned char>(symbol)];
+            if (users.empty() || users.back() != static_cast<int>(i)) {
+                users.push_back(static_cast<int>(i));
+            }
+        }
+    }
+
+    auto first_of_sequence = [&](const std::string &symbols, size_t from) {
+        SymbolSet result{kEpsilon};
+        for (auto i = from; i < symbols.size(); ++i) {
+            auto symbol = static_cast<unsigned char>(symbols[i]);
+            if (!is_nonterminal[symbol]) {
+                result.insert(symbols[i]);
+                result.erase(kEpsilon);
+                break;
+            }
+            auto nullable = first[symbol].contains(kEpsilon);
+            result |= first[symbol];
+            if (!nullable) {
+                result.erase(kEpsilon);
+                break;
+            }
+        }
+        return result;
+    };
+
+    // Productions of the real start are never used in the FIRST sets of user nonterminals.
+    std::vector<int> worklist;
+    std::vector<bool> queued(productions.size(), false);
+    for (auto i = dirty_productions.rbegin(); i != dirty_productions.rend(); ++i) {
+        if (*i != 0 && !queued[*i]) {
+            worklist.push_back(*i);
+            queued[*i] = true;
+        }
+    }
+    while (!worklist.empty()) {
+        auto production_id = worklist.back();
+        worklist.pop_back();
+        queued[production_id] = false;
+        auto &production = productions[production_id];
+        auto lhs = static_cast<unsigned char>(production.lhs);
+        if (!first[lhs].Merge(first_of_sequence(production.symbols, 0))) {
+            continue;
+        }
+        for (auto user: productions_using[lhs]) {
+            if (user != 0 && !queued[user]) {
+                queued[user] = true;
+                worklist.push_back(user);
+            }
+        }
+    }
+
+    for (auto &nonterminal: nonterminals) {
+        if (nonterminal.first == kRealStart) {
+            continue;
+        }
+        nonterminal.second.first = first[static_cast<unsigned char>(nonterminal.first)];
+        if (nonterminal.second.first.empty()) {
+            throw GrammarException("The grammar contains useless characters.");
+        }
+    }
+
+    first_of_suffix.assign(core_count, SymbolSet());
+    for (auto &production: productions) {
+        for (size_t position = 0; position <= production.length; ++position) {
+            first_of_suffix[production.core_offset + position] = first_of_sequence(production.symbols, position);
+        }
+    }
+}
+
+SymbolSet Algo::CalculateFirstOfChain(const std::string &chain) {
+    SymbolSet first_of_chain;
+    for (auto letter: chain) {
+        if (nonterminals.contains(letter)) {
+            first_of_chain |= nonterminals[letter].first;
+        } else {
+            first_of_chain.insert(letter);
+            first_of_chain.erase(kEpsilon);
+            break;
+        }
+        if (!nonterminals[letter].first.contains(kEpsilon)) {
+            first_of_chain.erase(kEpsilon);
+            break;
+        }
+
+    }
+    return first_of_chain;
+}
+
+int Algo::CoreId(const Item &item) const {
+    return static_cast<int>(productions[item.production].core_offset) + item.dot;
+}
+
+char Algo::SymbolAfterDot(const Item &item) const {
+    auto &production = productions[item.production];
+    if (static_cast<size_t>(item.dot) == production.length) {
+        return '\0';
+    }
+    return production.symbols[item.dot];
+}
+
+// As in yacc, a production takes the precedence of its last terminal.
+ActionType Algo::ResolveShiftReduce(char lookahead, int production) const {
+    auto &symbols = productions[production].symbols;
+    auto last_terminal = std::find_if(symbols.rbegin(), symbols.rend(), [this](char symbol) {
+        return !nonterminals.contains(symbol);
+    });
+    auto shift_precedence = precedence.find(lookahead);
+    if (last_terminal == symbols.rend() || shift_precedence == precedence.end()) {
+        return ActionType::kConflict;
+    }
+    auto reduce_precedence = precedence.find(*last_terminal);
+    if (reduce_precedence == precedence.end()) {
+        return ActionType::kConflict;
+    }
+    if (reduce_precedence->second.level != shift_precedence->second.level) {
+        return reduce_precedence->second.level > shift_precedence->second.level ? ActionType::kReduce
+                                                                                 : ActionType::kShift;
+    }
+    switch (shift_precedence->second.associativity) {
+        case Associativity::kLeft:
+            return ActionType::kReduce;
+        case Associativity::kRight:
+            return ActionType::kShift;
+        default:
+            return ActionType::kError;
+    }
+}
+
+std::string Algo::ItemToString(const Item &item) const {
+    auto &production = productions[item.production];
+    auto rhs = production.length == 0 ? production.rhs : production.symbols;
+    rhs.insert(rhs.begin() + item.dot, '.');
+    return std::string{production.lhs} + "->" + rhs;
+}
+
+CoreClosure Algo::CalculateCoreClosure(const std::vector<Item> &kernel) const {
+    CoreClosure core_closure;
+    std::vector<Item> items = kernel;
+    std::unordered_map<int, int> core_index;
+    for (size_t i = 0; i < items.size(); ++i) {
+        core_index.emplace(CoreId(items[i]), static_cast<int>(i));
+    }
+    for (size_t i = 0; i < items.size(); ++i) {
+        auto next_productions = productions_of.find(SymbolAfterDot(items[i]));
+        if (SymbolAfterDot(items[i]) == '\0' || next_productions == productions_of.end()) {
+            continue;
+        }
+        for (auto rule: next_productions->second) {
+            auto [slot, inserted] = core_index.emplace(static_cast<int>(productions[rule].core_offset),
+                                                       static_cast<int>(items.size()));
+            if (inserted) {
+                items.emplace_back(rule, 0, SymbolSet());
+                core_closure.productions.push_back(rule);
+            }
+            core_closure.edges.push_back({static_cast<int>(i), slot->second});
+            if (slot->second <= static_cast<int>(i)) {
+                core_closure.needs_fixed_point = true;
+            }
+        }
+    }
+    return core_closure;
+}
+
+std::vector<Item> Algo::Closure(std::vector<Item> items) {
+    return Closure(std::move(items), core_closures, construction_stats);
+}
+
+std::vector<Item> Algo::Closure(std::vector<Item> items, CoreClosureCacheType &cache, ConstructionStats &stats) const {
+    std::sort(items.begin(), items.end());
+    std::string key;
+    for (auto &item: items) {
+        auto core = CoreId(item);
+        key.append(reinterpret_cast<const char *>(&core), sizeof(core));
+    }
+    auto cached = cache.find(key);
+    if (cached == cache.end()) {
+        ++stats.core_closure_misses;
+        cached = cache.emplace(std::move(key), CalculateCoreClosure(items)).first;
+    } else {
+        ++stats.core_closure_hits;
+    }
+
+    auto &core_closure = cached->second;
+    for (auto rule: core_closure.productions) {
+        items.emplace_back(rule, 0, SymbolSet());
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &edge: core_closure.edges) {
+            auto &source = items[edge.source];
+            auto new_lookaheads = first_of_suffix[CoreId(source) + 1];
+            if (new_lookaheads.contains(kEpsilon)) {
+                new_lookaheads.erase(kEpsilon);
+                new_lookaheads |= source.lookaheads;
+            }
+            if (items[edge.target].lookaheads.Merge(new_lookaheads)) {
+                changed = core_closure.needs_fixed_point;
+            }
+        }
+    }
+    return items;
+}
+
+std::vector<Item> Algo::Transition(State &state, char symbol) {
+    std::vector<Item> new_items;
+    for (auto &item: state.items) {
+        if (SymbolAfterDot(item) == symbol) {
+            new_items.emplace_back(item.production, item.dot + 1, item.lookaheads);
+        }
+    }
+    return Closure(new_items);
+}
+
+int Algo::StateAlreadyExists(std::vector<Item> &curr_state) {
+    std::sort(curr_state.begin(), curr_state.end());
+    auto state = state_index.find(State::Fingerprint(State::Kernel(curr_state)));
+    if (state == state_index.end()) {
+        return -1;
+    }
+    return state->second;
+}
+
+int Algo::AddState(const std::vector<Item> &new_state) {
+    states.emplace_back(new_state, static_cast<int>(states.size()));
+    state_index.emplace(State::Fingerprint(State::Kernel(states.back().items)), states.back().personal_id);
+    return states.back().personal_id;
+}
+
+std::vector<std::pair<char, std::vector<Item>>> Algo::SuccessorKernels(const std::vector<Item> &items) const {
+    std::array<int, 256> bucket_of;
+    bucket_of.fill(-1);
+    std::vector<std::pair<char, std::vector<Item>>> kernels;
+    for (auto &item: items) {
+        auto symbol = SymbolAfterDot(item);
+        if (symbol == '\0' || (!terminals.contains(symbol) && !nonterminals.contains(symbol))) {
+            continue;
+        }
+        auto &bucket = bucket_of[static_cast<unsigned char>(symbol)];
+        if (bucket == -1) {
+            bucket = static_cast<int>(kernels.size());
+            kernels.emplace_back(symbol, std::vector<Item>());
+        }
+        kernels[bucket].second.emplace_back(item.production, item.dot + 1, item.lookaheads);
+    }
+    // Terminals first, then nonterminals, each in alphabetical order, as the states were always numbered.
+    std::sort(kernels.begin(), kernels.end(), [this](const auto &first, const auto &second) {
+        auto first_is_terminal = terminals.contains(first.first);
+        auto second_is_terminal = terminals.contains(second.first);
+        if (first_is_terminal != second_is_terminal) {
+            return first_is_terminal;
+        }
+        return first.first < second.first;
+    });
+    return kernels;
+}
+
+// Closures found in reusable_closures under the fingerprint of their sorted kernel are taken as they are.
+void Algo::CalculateStates(const KernelClosureCacheType *reusable_closures) {
+    auto closure_of = [this, reusable_closures](std::vector<Item> kernel) {
+        if (reusable_closures != nullptr) {
+            if (auto reused = reusable_closures->find(State::Fingerprint(kernel)); reused != reusable_closures->end()) {
+                ++construction_stats.reused_states;
+                return reused->second;
+            }
+        }
+        return Closure(std::move(kernel));
+    };
+    std::vector<Item> zero_state_set;
+    zero_state_set.emplace_back(0, 0, SymbolSet{kEndOfLine});
+    AddState(closure_of(zero_state_set));
+    if (states.back().items.size() == 1) {
+        throw GrammarException("The grammar is incorrect. There are no reachable symbols.");
+    }
+    if (options.threads > 1 && reusable_closures == nullptr) {
+        CalculateStatesInParallel();
+    } else {
+        for (size_t i = 0; i < states.size(); ++i) {
+            for (auto &[symbol, kernel]: SuccessorKernels(states[i].items)) {
+                std::sort(kernel.begin(), kernel.end());
+                auto state = state_index.find(State::Fingerprint(kernel));
+                if (state != state_index.end()) {
+                    ++construction_stats.kernel_hits;
+                    states[i].transitions[symbol] = state->second;
+                    continue;
+                }
+                ++construction_stats.kernel_misses;
+                states[i].transitions[symbol] = AddState(closure_of(std::move(kernel)));
+            }
+        }
+    }
+    if (auto start = states[0].transitions.find(productions[0].symbols[0]); start != states[0].transitions.end()) {
+        accept_state_id = start->second;
+    }
+}
+
+// parallel automaton construction
+
+namespace {
+
+struct StateNode {
+    std::vector<Item> kernel;
+    std::vector<Item> items;
+    std::vector<std::pair<char, StateNode *>> successors;
+    int id = kNoState;
+};
+
+class ConcurrentStateIndex {
+public:
+    static auto const kShardsNumber = 64;
+
+    // Returns the node of the kernel and whether it has been created by this call.
+    std::pair<StateNode *, bool> FindOrAdd(std::vector<Item> &&kernel) {
+        auto fingerprint = State::Fingerprint(kernel);
+        auto &shard = shards_[std::hash<std::string>()(fingerprint) % kShardsNumber];
+        std::lock_guard lock(shard.mutex);
+        auto [node, inserted] = shard.nodes.try_emplace(std::move(fingerprint));
+        if (inserted) {
+            node->second = std::make_unique<StateNode>();
+            node->second->kernel = std::move(kernel);
+        }
+        return {node->second.get(), inserted};
+    }
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<StateNode>> nodes;
+    };
+
+    std::array<Shard, kShardsNumber> shards_;
+};
+
+class WorkStealingQueues {
+public:
+    explicit WorkStealingQueues(size_t workers_number) : queues_(workers_number) {
+    }
+
+    void Push(size_t worker, StateNode *node) {
+        ++pending_;
+        std::lock_guard lock(queues_[worker].mutex);
+        queues_[worker].nodes.push_back(node);
+    }
+
+    // Takes the newest node of the worker's own queue or steals the oldest node of another one.
+    // Returns nullptr once every pushed node has been finished.
+    StateNode *Pop(size_t worker) {
+        while (true) {
+            for (size_t shift = 0; shift < queues_.size(); ++shift) {
+                auto &queue = queues_[(worker + shift) % queues_.size()];
+                std::lock_guard lock(queue.mutex);
+                if (queue.nodes.empty()) {
+                    continue;
+                }
+                StateNode *node;
+                if (shift == 0) {
+                    node = queue.nodes.back();
+                    queue.nodes.pop_back();
+                } else {
+                    node = queue.nodes.front();
+                    queue.nodes.pop_front();
+                }
+                return node;
+            }
+            if (pending_ == 0) {
+                return nullptr;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void Finish() {
+        --pending_;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<StateNode *> nodes;
+    };
+
+    std::vector<Queue> queues_;
+    std::atomic<size_t> pending_ = 0;
+};
+
+}
+
+void Algo::CalculateStatesInParallel() {
+    ConcurrentStateIndex index;
+    WorkStealingQueues queues(options.threads);
+    std::mutex results_mutex;
+
+    auto root = index.FindOrAdd(State::Kernel(states[0].items)).first;
+    root->items = states[0].items;
+    queues.Push(0, root);
+
+    auto expand = [&](size_t worker) {
+        CoreClosureCacheType cache;
+        ConstructionStats stats;
+        while (auto node = queues.Pop(worker)) {
+            if (node->items.empty()) {
+                node->items = Closure(node->kernel, cache, stats);
+            }
+            for (auto &[symbol, kernel]: SuccessorKernels(node->items)) {
+                std::sort(kernel.begin(), kernel.end());
+                auto [successor, created] = index.FindOrAdd(std::move(kernel));
+                if (created) {
+                    ++stats.kernel_misses;
+                    queues.Push(worker, successor);
+                } else {
+                    ++stats.kernel_hits;
+                }
+                node->successors.emplace_back(symbol, successor);
+            }
+            queues.Finish();
+        }
+        std::lock_guard lock(results_mutex);
+        construction_stats.kernel_hits += stats.kernel_hits;
+        construction_stats.kernel_misses += stats.kernel_misses;
+        construction_stats.core_closure_hits += stats.core_closure_hits;
+        construction_stats.core_closure_misses += stats.core_closure_misses;
+        core_closures.merge(cache);
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t worker = 1; worker < options.threads; ++worker) {
+        workers.emplace_back(expand, worker);
+    }
+    expand(0);
+    for (auto &worker: workers) {
+        worker.join();
+    }
+
+    // Number the states in the order the sequential construction discovers them.
+    std::vector<StateNode *> order{root};
+    root->id = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (auto &successor: order[i]->successors) {
+            if (successor.second->id == kNoState) {
+                successor.second->id = static_cast<int>(order.size());
+                order.push_back(successor.second);
+            }
+        }
+    }
+    for (size_t i = 1; i < order.size(); ++i) {
+        AddState(order[i]->items);
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (auto &successor: order[i]->successors) {
+            states[i].transitions[successor.first] = successor.second->id;
+        }
+    }
+}
+
+// Merges canonical states with equal LR(0) cores whenever the union of their lookaheads
+// introduces no reduce/reduce conflict. Shift symbols only depend on the core, so no
+// shift/reduce conflict can appear either. Groups are then split until every member of
+// a group has its successors in the same groups, so the merged automaton is consistent.
+void Algo::MergeStates() {
+    auto cores_of = [](const State &state) {
+        std::string cores;
+        for (auto &item: state.items) {
+            cores.append(reinterpret_cast<const char *>(&item.production), sizeof(item.production));
+            cores.append(reinterpret_cast<const char *>(&item.dot), sizeof(item.dot));
+        }
+        return cores;
+    };
+
+    std::vector<int> group_of(states.size());
+    std::vector<std::vector<SymbolSet>> group_lookaheads;
+    std::unordered_map<std::string, std::vector<int>> groups_by_core;
+    for (auto &state: states) {
+        std::vector<size_t> reduce_items;
+        for (size_t k = 0; k < state.items.size(); ++k) {
+            if (SymbolAfterDot(state.items[k]) == '\0') {
+                reduce_items.push_back(k);
+            }
+        }
+        auto &candidates = groups_by_core[cores_of(state)];
+        auto group = kNoState;
+        for (auto candidate: candidates) {
+            auto &lookaheads = group_lookaheads[candidate];
+            SymbolSet seen;
+            bool compatible = true;
+            for (auto k: reduce_items) {
+                auto merged = lookaheads[k];
+                merged |= state.items[k].lookaheads;
+                for (size_t word = 0; word < SymbolSet::kWordsNumber; ++word) {
+                    compatible = compatible && (seen.words[word] & merged.words[word]) == 0;
+                }
+                seen |= merged;
+            }
+            if (compatible) {
+                group = candidate;
+                break;
+            }
+        }
+        if (group == kNoState) {
+            group = static_cast<int>(group_lookaheads.size());
+            group_lookaheads.emplace_back(state.items.size());
+            candidates.push_back(group);
+        }
+        for (size_t k = 0; k < state.items.size(); ++k) {
+            group_lookaheads[group][k] |= state.items[k].lookaheads;
+        }
+        group_of[state.personal_id] = group;
+    }
+
+    auto groups_number = group_lookaheads.size();
+    bool split = true;
+    while (split) {
+        split = false;
+        std::map<std::pair<int, std::vector<int>>, int> refined;
+        std::vector<int> refined_group_of(states.size());
+        std::vector<bool> group_used(groups_number, false);
+        for (auto &state: states) {
+            std::vector<int> successors;
+            for (auto &transition: state.transitions) {
+                successors.push_back(group_of[transition.second]);
+            }
+            auto group = group_of[state.personal_id];
+            auto [signature, inserted] = refined.try_emplace({group, std::move(successors)}, group);
+            if (inserted && group_used[group]) {
+                signature->second = static_cast<int>(groups_number++);
+                split = true;
+            }
+            group_used[group] = true;
+            refined_group_of[state.personal_id] = signature->second;
+        }
+        group_of = std::move(refined_group_of);
+    }
+
+    std::vector<int> new_id(groups_number, kNoState);
+    std::vector<std::vector<Item>> merged_items;
+    std::vector<std::map<char, int>> merged_transitions;
+    for (auto &state: states) {
+        auto &id = new_id[group_of[state.personal_id]];
+        if (id == kNoState) {
+            id = static_cast<int>(merged_items.size());
+            merged_items.emplace_back(state.items.size(), Item(0, 0, SymbolSet()));
+            merged_transitions.emplace_back();
+            for (size_t k = 0; k < state.items.size(); ++k) {
+                merged_items[id][k] = Item(state.items[k].production, state.items[k].dot, SymbolSet());
+            }
+        }
+        for (size_t k = 0; k < state.items.size(); ++k) {
+            merged_items[id][k].lookaheads |= state.items[k].lookaheads;
+        }
+    }
+    for (auto &state: states) {
+        for (auto &transition: state.transitions) {
+            merged_transitions[new_id[group_of[state.personal_id]]][transition.first] =
+                    new_id[group_of[transition.second]];
+        }
+    }
+
+    states.clear();
+    state_index.clear();
+    for (size_t i = 0; i < merged_items.size(); ++i) {
+        AddState(merged_items[i]);
+        states.back().transitions = std::move(merged_transitions[i]);
+    }
+    if (accept_state_id != kNoState) {
+        accept_state_id = states[0].transitions[productions[0].symbols[0]];
+    }
+}
+
+// Table with every cell empty and the per-production columns filled in.
+static ParseTable EmptyTable(const Algo &parser, size_t states_number) {
+    std::vector<char> nonterminal_symbols;
+    for (auto &nonterminal: parser.nonterminals) {
+        if (nonterminal.first != kRealStart) {
+            nonterminal_symbols.push_back(nonterminal.first);
+        }
+    }
+    ParseTable table(states_number, parser.terminals, nonterminal_symbols);
+    for (auto &production: parser.productions) {
+        table.production_lengths.push_back(static_cast<std::uint32_t>(production.length));
+        table.production_lhs.push_back(table.Column(production.lhs));
+    }
+    return table;
+}
+
+// Fills the action and goto row of a state with the given closure items and transitions. Shift/reduce conflicts
+// are first decided by the declared precedences. Conflicts left throw unless `conflicts` is given, in which case
+// the cell becomes kConflict pointing at their list.
+static void FillTableRow(const Algo &parser, const std::array<int, 256> &column,
+                         const std::vector<Item> &items, const std::map<char, int> &transitions,
+                         ParseTable::ActionCell *actions, int *gotos,
+                         std::vector<std::vector<ParseTable::ActionCell>> *conflicts = nullptr) {
+    // Reductions that precedence removed from a column, because the shift won or a %nonassoc operator turned the
+    // cell into an error. Precedence only orders a shift against a reduction, so a second reduction on the column
+    // is still a reduce/reduce conflict with them.
+    std::map<int, std::vector<ParseTable::ActionCell>> resolved_reductions;
+    auto add_action = [conflicts](ParseTable::ActionCell &cell, ParseTable::ActionCell action) {
+        if (ParseTable::TypeOf(cell) == ActionType::kError) {
+            cell = action;
+            return;
+        }
+        if (conflicts == nullptr) {
+            std::string error;
+            if (ParseTable::TypeOf(cell) == ActionType::kShift) {
+                error = "Shift/Reduce conflict occurred. The grammar is no LR(1) type.";
+            } else {
+                error = "Reduce/Reduce conflict occurred. The grammar is no LR(1) type.";
+            }
+            throw GrammarException(error);
+        }
+        if (ParseTable::TypeOf(cell) != ActionType::kConflict) {
+            conflicts->push_back({cell});
+            cell = ParseTable::MakeAction(ActionType::kConflict, static_cast<int>(conflicts->size() - 1));
+        }
+        auto &conflicting = (*conflicts)[ParseTable::ValueOf(cell)];
+        if (std::find(conflicting.begin(), conflicting.end(), action) == conflicting.end()) {
+            conflicting.push_back(action);
+        }
+    };
+    for (auto &transition: transitions) {
+        auto symbol_column = column[static_cast<unsigned char>(transition.first)];
+        if (parser.terminals.contains(transition.first)) {
+            actions[symbol_column] = ParseTable::MakeAction(ActionType::kShift, transition.second);
+        } else {
+            gotos[symbol_column] = transition.second;
+        }
+    }
+    for (auto &item: items) {
+        if (parser.SymbolAfterDot(item) == '\0') {
+            auto action = item.production == 0 ? ParseTable::MakeAction(ActionType::kAccept)
+                                               : ParseTable::MakeAction(ActionType::kReduce, item.production);
+            for (auto lookahead: item.lookaheads) {
+                auto lookahead_column = column[static_cast<unsigned char>(lookahead)];
+                if (lookahead_column == kNoColumn) {
+                    continue;
+                }
+                auto &cell = actions[lookahead_column];
+                if (auto resolved = resolved_reductions.find(lookahead_column); resolved != resolved_reductions.end()) {
+                    if (conflicts == nullptr) {
+                        throw GrammarException("Reduce/Reduce conflict occurred. The grammar is no LR(1) type.");
+                    }
+                    for (auto reduction: resolved->second) {
+                        add_action(cell, reduction);
+                    }
+                    resolved_reductions.erase(resolved);
+                    add_action(cell, action);
+                    continue;
+                }
+                if (ParseTable::TypeOf(cell) == ActionType::kShift && item.production != 0) {
+                    auto resolution = parser.ResolveShiftReduce(lookahead, item.production);
+                    if (resolution == ActionType::kShift) {
+                        resolved_reductions[lookahead_column].push_back(action);
+                        continue;
+                    }
+                    if (resolution == ActionType::kReduce) {
+                        cell = action;
+                        continue;
+                    }
+                    if (resolution == ActionType::kError) {
+                        resolved_reductions[lookahead_column].push_back(action);
+                        cell = ParseTable::MakeAction(ActionType::kError);
+                        continue;
+                    }
+                }
+                add_action(cell, action);
+            }
+        }
+    }
+}
+
+void Algo::MakeTable() {
+    table = EmptyTable(*this, states.size());
+    for (size_t i = 0; i < states.size(); ++i) {
+        FillTableRow(*this, table.column, states[i].items, states[i].transitions,
+                     table.actions.data() + i * table.terminal_count, table.gotos.data() + i * table.nonterminal_count,
+                     options.glr ? &table.conflicts : nullptr);
+    }
+}
+
+std::uint64_t Algo::GrammarHash() const {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (auto &production: productions) {
+        for (auto symbol: std::string{production.lhs} + "->" + production.rhs + "\n") {
+            hash = (hash ^ static_cast<unsigned char>(symbol)) * 0x100000001b3ULL;
+        }
+    }
+    // Precedences change the table, so they take part in the hash; grammars without them keep their old hash.
+    for (auto &[symbol, declared]: precedence) {
+        for (auto value: {static_cast<int>(static_cast<unsigned char>(symbol)), declared.level,
+                          static_cast<int>(declared.associativity)}) {
+            hash = (hash ^ static_cast<std::uint64_t>(value)) * 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
+TableView Algo::View() const {
+    return table_file ? table_file_view : table.View();
+}
+
+struct NoStateObserver {
+    void Enter(int, int) const {
+    }
+};
+
+enum class StepOutcome {
+    kShifted,
+    kAccepted,
+    kRejected
+};
+
+// One lookahead of the LR driver: runs the reductions the symbol in `column` triggers, then shifts, accepts or
+// rejects it. The drivers only differ in how they keep the state stack, so it is reached through an adapter with
+// Top(), Pop(count) and Push(state); on_reduce sees every production before its right side is popped.
+template<typename Table, typename Stack, typename OnReduce>
+static StepOutcome StepAutomaton(const Table &table_view, int column, Stack &stack, OnReduce &&on_reduce) {
+    if (column == kNoColumn) {
+        return StepOutcome::kRejected;
+    }
+    auto action = table_view.Action(stack.Top(), column);
+    while (ParseTable::TypeOf(action) == ActionType::kReduce) {
+        auto production = ParseTable::ValueOf(action);
+        on_reduce(production);
+        stack.Pop(table_view.production_lengths[production]);
+        auto next_state = table_view.Goto(stack.Top(), table_view.production_lhs[production]);
+        if (next_state == kNoState) {
+            return StepOutcome::kRejected;
+        }
+        stack.Push(next_state);
+        action = table_view.Action(stack.Top(), column);
+    }
+    switch (ParseTable::TypeOf(action)) {
+        case ActionType::kShift:
+            stack.Push(ParseTable::ValueOf(action));
+            return StepOutcome::kShifted;
+        case ActionType::kAccept:
+            return StepOutcome::kAccepted;
+        default:
+            return StepOutcome::kRejected;
+    }
+}
+
+// Stack adapter over a plain vector of states; the observer sees every push with the state it comes from.
+template<typename Observer = NoStateObserver>
+class VectorStack {
+public:
+    explicit VectorStack(std::vector<int> &states, Observer observer = {}) : states_(states), observer_(observer) {
+    }
+
+    int Top() const {
+        return states_.back();
+    }
+
+    void Pop(size_t count) {
+        states_.resize(states_.size() - count);
+    }
+
+    void Push(int state) {
+        observer_.Enter(states_.back(), state);
+        states_.push_back(state);
+    }
+
+private:
+    std::vector<int> &states_;
+    Observer observer_;
+};
+
+// LR driver shared by Parse and Recognize. Returns the offset of the first offending character or
+// RecognizeResult::kNoError once the word is accepted; reductions are only recorded when requested.
+// Works on any table with the lookup interface of TableView. The observer sees every state pushed on
+// the stack together with the state it is entered from.
+template<bool kRecordReductions, typename Table, typename Observer = NoStateObserver>
+static size_t RunAutomaton(const Table &table_view, std::string_view input, ParseContext &context,
+                           Observer observer = {}) {
+    if (input.size() == 1 && input[0] == kEpsilon) {
+        input = {};
+    }
+    context.stack.clear();
+    if constexpr (kRecordReductions) {
+        context.reductions.clear();
+    }
+    context.stack.push_back(0);
+    observer.Enter(kNoState, 0);
+    VectorStack stack(context.stack, observer);
+    auto on_reduce = [&context](int production) {
+        if constexpr (kRecordReductions) {
+            context.reductions.push_back(production);
+        }
+    };
+    for (size_t i = 0; i <= input.size(); ++i) {
+        auto symbol = i == input.size() ? kEndOfLine : input[i];
+        if (symbol == kEndOfLine && i != input.size()) {
+            return i;
+        }
+        switch (StepAutomaton(table_view, table_view.Column(symbol), stack, on_reduce)) {
+            case StepOutcome::kShifted:
+                break;
+            case StepOutcome::kAccepted:
+                on_reduce(0);
+                return RecognizeResult::kNoError;
+            case StepOutcome::kRejected:
+                return i;
+        }
+    }
+    return input.size();
+}
+
+namespace {
+
+// Resumable LR driver that stops after every reduction, so the same loop feeds both the callback and the coroutine.
+// Next to the state stack, span_starts keeps the input offset where the symbol of every stack entry starts.
+// The table must outlive the cursor.
+template<typename Table>
+class ReduceEventCursor {
+public:
+    ReduceEventCursor(const Table &table_view, std::string_view input, ParseContext &context,
+                      ParseTree *tree = nullptr) :
+            table_view_(table_view), input_(input), context_(context), tree_(tree) {
+        if (input_.size() == 1 && input_[0] == kEpsilon) {
+            input_ = {};
+        }
+        context_.stack.assign(1, 0);
+        context_.span_starts.assign(1, 0);
+        LoadLookahead();
+    }
+
+    // Returns false once the word has been accepted or rejected.
+    bool Next(ReduceEvent &event) {
+        auto &stack = context_.stack;
+        auto &span_starts = context_.span_starts;
+        while (!finished_) {
+            switch (ParseTable::TypeOf(action_)) {
+                case ActionType::kReduce: {
+                    auto production = ParseTable::ValueOf(action_);
+                    auto length = table_view_.production_lengths[production];
+                    auto begin = length == 0 ? position_ : span_starts[span_starts.size() - length];
+                    stack.resize(stack.size() - length);
+                    span_starts.resize(span_starts.size() - length);
+                    auto next_state = table_view_.Goto(stack.back(), table_view_.production_lhs[production]);
+                    if (next_state == kNoState) {
+                        finished_ = true;
+                        return false;
+                    }
+                    stack.push_back(next_state);
+                    span_starts.push_back(begin);
+                    action_ = table_view_.Action(stack.back(), column_);
+                    event = {production, begin, position_};
+                    AddTreeNode(event, length);
+                    return true;
+                }
+                case ActionType::kShift:
+                    stack.push_back(ParseTable::ValueOf(action_));
+                    span_starts.push_back(position_);
+                    AddTreeNode({ParseTree::kTokenNode, position_, position_ + 1}, 0);
+                    ++position_;
+                    LoadLookahead();
+                    break;
+                case ActionType::kAccept:
+                    finished_ = true;
+                    accepted_ = true;
+                    event = {0, 0, input_.size()};
+                    AddTreeNode(event, 1);
+                    return true;
+                default:
+                    finished_ = true;
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    bool Accepted() const {
+        return accepted_;
+    }
+
+private:
+    // The children are the last `length` subtrees, found by jumping over each of them from the end.
+    void AddTreeNode(const ReduceEvent &event, size_t length) {
+        if (tree_ == nullptr) {
+            return;
+        }
+        auto first = tree_->nodes.size();
+        for (size_t i = 0; i < length; ++i) {
+            first -= tree_->nodes[first - 1].child_offset + 1;
+        }
+        tree_->nodes.push_back({event.production, static_cast<std::uint32_t>(tree_->nodes.size() - first),
+                                static_cast<std::uint32_t>(event.begin), static_cast<std::uint32_t>(event.end)});
+    }
+
+    void LoadLookahead() {
+        auto symbol = position_ == input_.size() ? kEndOfLine : input_[position_];
+        column_ = symbol == kEndOfLine && position_ != input_.size() ? kNoColumn : table_view_.Column(symbol);
+        action_ = column_ == kNoColumn ? ParseTable::MakeAction(ActionType::kError)
+                                       : table_view_.Action(context_.stack.back(), column_);
+    }
+
+    const Table &table_view_;
+    std::string_view input_;
+    ParseContext &context_;
+    ParseTree *tree_;
+    size_t position_ = 0;
+    int column_ = kNoColumn;
+    ParseTable::ActionCell action_ = 0;
+    bool finished_ = false;
+    bool accepted_ = false;
+};
+
+}  // namespace
+
+template<typename Table>
+static bool ParseWithCallback(const Table &table_view, std::string_view input, ParseContext &context,
+                              const ReduceCallback &on_reduce) {
+    ReduceEventCursor cursor(table_view, input, context);
+    ReduceEvent event{};
+    while (cursor.Next(event)) {
+        on_reduce(event);
+    }
+    return cursor.Accepted();
+}
+
+// Table is taken by value, so views can be handed over as temporaries; owned tables are passed by reference.
+template<typename Table>
+static Generator<ReduceEvent> GenerateReduceEvents(Table table_view, std::string_view input) {
+    ParseContext context;
+    ReduceEventCursor<std::unwrap_reference_t<Table>> cursor(table_view, input, context);
+    ReduceEvent event{};
+    while (cursor.Next(event)) {
+        co_yield event;
+    }
+}
+
+namespace {
+
+// Tomita-style GLR driver over a graph-structured stack. The stacks alive after the same prefix form one level
+// with a node per state, so stacks that meet in a state merge and share the reductions below. Edges carry the
+// forest node of the symbol between their two stack entries. A new edge into a node whose reductions already ran
+// can open new reduction paths, so the reductions of the level then run again until no edge is added.
+// While a single stack head is live and its cell holds one action, the driver runs as a plain LR parser on a
+// linear stack above one GSS node and turns that stack into GSS nodes only when a conflict or a reduction
+// reaching below it needs the graph, so deterministic stretches of the input cost about as much as LR parsing.
+class GlrDriver {
+public:
+    GlrDriver(const Algo &parser, ParseForest *forest) :
+            parser_(parser), table_view_(parser.View()), forest_(forest) {
+    }
+
+    // Returns the offset of the first character no stack can shift or RecognizeResult::kNoError.
+    size_t Run(std::string_view input) {
+        if (input.size() == 1 && input[0] == kEpsilon) {
+            input = {};
+        }
+        input_ = input;
+        // Inputs that never leave the deterministic path need neither the state map nor more than the base node.
+        nodes_.push_back({0, 0, kNoNode, false});
+        base_ = 0;
+        linear_.reserve(ParseContext::kDefaultStackCapacity);
+        deterministic_ = true;
+        if (forest_ != nullptr) {
+            forest_->Clear();
+        }
+        for (size_t i = 0; i <= input.size(); ++i) {
+            auto symbol = i == input.size() ? kEndOfLine : input[i];
+            if (symbol == kEndOfLine && i != input.size()) {
+                return i;
+            }
+            column_ = table_view_.Column(symbol);
+            if (column_ == kNoColumn) {
+                return i;
+            }
+            position_ = static_cast<std::uint32_t>(i);
+            if (forest_ != nullptr) {
+                forest_index_.clear();
+            }
+            if (deterministic_) {
+                auto step = StepDeterministic();
+                if (step == Step::kShifted) {
+                    continue;
+                }
+                if (step == Step::kRejected) {
+                    return i;
+                }
+                if (step == Step::kAccepted) {
+                    break;
+                }
+            }
+            ReduceLevel();
+            if (i == input.size()) {
+                break;
+            }
+            ShiftLevel();
+            if (level_.empty()) {
+                return i;
+            }
+            if (level_.size() == 1) {
+                EnterDeterministic();
+            }
+        }
+        if (!accepted_) {
+            return input.size();
+        }
+        if (forest_ != nullptr) {
+            forest_->root = static_cast<int>(forest_->nodes.size());
+            forest_->nodes.push_back({kRealStart, 0, position_, ParseForest::kNoNode});
+            path_.assign(1, accepted_label_);
+            AddAlternative(forest_->root, 0);
+        }
+        return RecognizeResult::kNoError;
+    }
+
+private:
+    static constexpr auto kNoNode = -1;
+
+    struct GssNode {
+        int state;
+        std::uint32_t level;
+        int first_edge;
+        bool processed;
+    };
+
+    struct GssEdge {
+        int target;
+        int label;
+        int next;
+    };
+
+    // Entry of the linear stack: a GSS node not created yet, with the label of its edge to the entry below.
+    struct LinearEntry {
+        int state;
+        std::uint32_t level;
+        int label;
+    };
+
+    enum class Step {
+        kShifted,
+        kAccepted,
+        kRejected,
+        kSwitchedToGss
+    };
+
+    // The single head of the level becomes the base of an empty linear stack.
+    void EnterDeterministic() {
+        base_ = level_[0];
+        node_of_state_[nodes_[base_].state] = kNoNode;
+        level_.clear();
+        linear_.clear();
+        deterministic_ = true;
+    }
+
+    // Runs LR actions on the linear stack until the lookahead is shifted or the GSS is needed. The head an LR
+    // reduction pops has no other action on this lookahead, so dropping it loses nothing.
+    Step StepDeterministic() {
+        while (true) {
+            auto state = linear_.empty() ? nodes_[base_].state : linear_.back().state;
+            auto action = table_view_.Action(state, column_);
+            auto value = ParseTable::ValueOf(action);
+            switch (ParseTable::TypeOf(action)) {
+                case ActionType::kShift:
+                    linear_.push_back({value, position_ + 1, forest_ != nullptr ? TokenNode() : kNoNode});
+                    return Step::kShifted;
+                case ActionType::kReduce: {
+                    auto length = table_view_.production_lengths[value];
+                    if (length > linear_.size()) {
+                        break;
+                    }
+                    auto below = linear_.size() - length;
+                    auto target_state = below == 0 ? nodes_[base_].state : linear_[below - 1].state;
+                    auto target_level = below == 0 ? nodes_[base_].level : linear_[below - 1].level;
+                    auto label = kNoNode;
+                    if (forest_ != nullptr) {
+                        label = ForestNodeOf(parser_.productions[value].lhs, target_level);
+                        path_.clear();
+                        for (auto entry = below; entry < linear_.size(); ++entry) {
+                            path_.push_back(linear_[entry].label);
+                        }
+                        AddAlternative(label, value);
+                    }
+                    linear_.resize(below);
+                    auto next_state = table_view_.Goto(target_state, table_view_.production_lhs[value]);
+                    if (next_state == kNoState) {
+                        return Step::kRejected;
+                    }
+                    linear_.push_back({next_state, position_, label});
+                    continue;
+                }
+                case ActionType::kAccept:
+                    if (linear_.empty()) {
+                        break;
+                    }
+                    accepted_ = true;
+                    accepted_label_ = linear_.back().label;
+                    return Step::kAccepted;
+                case ActionType::kConflict:
+                    break;
+                default:
+                    return Step::kRejected;
+            }
+            MaterializeLinearStack();
+            return Step::kSwitchedToGss;
+        }
+    }
+
+    // Turns the linear stack into a chain of GSS nodes; its top is the only node of the current level.
+    void MaterializeLinearStack() {
+        auto below = base_;
+        for (auto &entry: linear_) {
+            nodes_.push_back({entry.state, entry.level, kNoNode, false});
+            AddEdge(static_cast<int>(nodes_.size() - 1), below, entry.label);
+            below = static_cast<int>(nodes_.size() - 1);
+        }
+        linear_.clear();
+        if (node_of_state_.empty()) {
+            node_of_state_.assign(table_view_.state_count, kNoNode);
+        }
+        node_of_state_[nodes_[below].state] = below;
+        level_.assign(1, below);
+        deterministic_ = false;
+    }
+
+    int AddNode(int state, std::uint32_t level) {
+        nodes_.push_back({state, level, kNoNode, false});
+        node_of_state_[state] = static_cast<int>(nodes_.size() - 1);
+        return node_of_state_[state];
+    }
+
+    void AddEdge(int node, int target, int label) {
+        edges_.push_back({target, label, nodes_[node].first_edge});
+        nodes_[node].first_edge = static_cast<int>(edges_.size() - 1);
+    }
+
+    template<typename Function>
+    void ForEachAction(int state, Function function) const {
+        auto cell = table_view_.Action(state, column_);
+        if (ParseTable::TypeOf(cell) != ActionType::kConflict) {
+            function(cell);
+            return;
+        }
+        for (auto action: parser_.table.conflicts[ParseTable::ValueOf(cell)]) {
+            function(action);
+        }
+    }
+
+    void ReduceLevel() {
+        shifts_.clear();
+        for (bool first_pass = true; first_pass || rerun_; first_pass = false) {
+            rerun_ = false;
+            // Reductions append new nodes to the level, so the bound is read on every iteration.
+            for (size_t i = 0; i < level_.size(); ++i) {
+                auto node = level_[i];
+                if (!nodes_[node].processed) {
+                    nodes_[node].processed = true;
+                    Act(node);
+                } else {
+                    ForEachAction(nodes_[node].state, [this, node](ParseTable::ActionCell action) {
+                        if (ParseTable::TypeOf(action) == ActionType::kReduce) {
+                            Reduce(node, ParseTable::ValueOf(action));
+                        }
+                    });
+                }
+            }
+        }
+    }
+
+    void Act(int node) {
+        ForEachAction(nodes_[node].state, [this, node](ParseTable::ActionCell action) {
+            switch (ParseTable::TypeOf(action)) {
+                case ActionType::kShift:
+                    shifts_.emplace_back(node, ParseTable::ValueOf(action));
+                    break;
+                case ActionType::kReduce:
+                    Reduce(node, ParseTable::ValueOf(action));
+                    break;
+                case ActionType::kAccept:
+                    accepted_ = true;
+                    accepted_label_ = edges_[nodes_[node].first_edge].label;
+                    break;
+                default:
+                    break;
+            }
+        });
+    }
+
+    void Reduce(int node, int production) {
+        path_.clear();
+        WalkPaths(node, table_view_.production_lengths[production], production);
+    }
+
+    // Follows every path of `remaining` edges down from node; path_ collects the labels from the top.
+    void WalkPaths(int node, std::uint32_t remaining, int production) {
+        if (remaining == 0) {
+            Reducer(node, production);
+            return;
+        }
+        for (auto edge = nodes_[node].first_edge; edge != kNoNode; edge = edges_[edge].next) {
+            path_.push_back(edges_[edge].label);
+            WalkPaths(edges_[edge].target, remaining - 1, production);
+            path_.pop_back();
+        }
+    }
+
+    // Pushes the left-hand side of the production on top of `target`, the node the reduced path ends at.
+    void Reducer(int target, int production) {
+        auto state = table_view_.Goto(nodes_[target].state, table_view_.production_lhs[production]);
+        if (state == kNoState) {
+            return;
+        }
+        auto label = kNoNode;
+        if (forest_ != nullptr) {
+            label = ForestNodeOf(parser_.productions[production].lhs, nodes_[target].level);
+            std::reverse(path_.begin(), path_.end());
+            AddAlternative(label, production);
+            std::reverse(path_.begin(), path_.end());
+        }
+        auto node = node_of_state_[state];
+        if (node == kNoNode) {
+            level_.push_back(AddNode(state, position_));
+            AddEdge(level_.back(), target, label);
+            return;
+        }
+        for (auto edge = nodes_[node].first_edge; edge != kNoNode; edge = edges_[edge].next) {
+            // Every state is entered by a single symbol, so the edge already carries the same forest node.
+            if (edges_[edge].target == target) {
+                return;
+            }
+        }
+        AddEdge(node, target, label);
+        rerun_ = rerun_ || nodes_[node].processed;
+    }
+
+    void ShiftLevel() {
+        for (auto node: level_) {
+            node_of_state_[nodes_[node].state] = kNoNode;
+        }
+        level_.clear();
+        auto label = forest_ != nullptr && !shifts_.empty() ? TokenNode() : kNoNode;
+        for (auto [target, state]: shifts_) {
+            auto node = node_of_state_[state];
+            if (node == kNoNode) {
+                node = AddNode(state, position_ + 1);
+                level_.push_back(node);
+            }
+            AddEdge(node, target, label);
+        }
+    }
+
+    int TokenNode() {
+        forest_->nodes.push_back({input_[position_], position_, position_ + 1, ParseForest::kNoNode});
+        return static_cast<int>(forest_->nodes.size() - 1);
+    }
+
+    // Forest nodes of the current level are keyed by symbol and start; all of them end at the current position.
+    int ForestNodeOf(char symbol, std::uint32_t begin) {
+        auto key = (static_cast<std::uint64_t>(begin) << 8) | static_cast<unsigned char>(symbol);
+        auto [entry, inserted] = forest_index_.try_emplace(key, static_cast<int>(forest_->nodes.size()));
+        if (inserted) {
+            forest_->nodes.push_back({symbol, begin, position_, ParseForest::kNoNode});
+        }
+        return entry->second;
+    }
+
+    // Appends the alternative with children path_ unless the node already has it. Appending keeps the first
+    // alternative of every node built from nodes that existed before it, so first alternatives never form a cycle.
+    void AddAlternative(int node, int production) {
+        auto *link = &forest_->nodes[node].first_alternative;
+        for (; *link != ParseForest::kNoNode; link = &forest_->alternatives[*link].next) {
+            auto &alternative = forest_->alternatives[*link];
+            if (alternative.production == production && alternative.child_count == path_.size() &&
+                std::equal(path_.begin(), path_.end(), forest_->children.begin() + alternative.first_child)) {
+                return;
+            }
+        }
+        *link = static_cast<int>(forest_->alternatives.size());
+        forest_->alternatives.push_back({production, static_cast<std::uint32_t>(forest_->children.size()),
+                                         static_cast<std::uint32_t>(path_.size()), ParseForest::kNoNode});
+        forest_->children.insert(forest_->children.end(), path_.begin(), path_.end());
+    }
+
+    const Algo &parser_;
+    TableView table_view_;
+    ParseForest *forest_;
+    std::string_view input_;
+    std::vector<GssNode> nodes_;
+    std::vector<GssEdge> edges_;
+    std::vector<int> node_of_state_;
+    std::vector<int> level_;
+    std::vector<LinearEntry> linear_;
+    std::vector<std::pair<int, int>> shifts_;
+    std::unordered_map<std::uint64_t, int> forest_index_;
+    std::vector<int> path_;
+    std::uint32_t position_ = 0;
+    int column_ = kNoColumn;
+    int base_ = kNoNode;
+    int accepted_label_ = kNoNode;
+    bool accepted_ = false;
+    bool deterministic_ = false;
+    bool rerun_ = false;
+};
+
+}  // namespace
+
+// function RequireCompleteTable
+
+void RequireCompleteTable(const Algo &parser) {
+    if (parser.lazy_table) {
+        throw std::logic_error("A lazily built parser has no complete table.");
+    }
+}
+
+// function RequireDeterministicTable
+
+void RequireDeterministicTable(const Algo &parser) {
+    if (!parser.table.conflicts.empty()) {
+        throw std::logic_error("The table has conflicting actions; only the GLR driver can parse with it.");
+    }
+}
+
+// View of the complete, conflict-free table that the drivers following a single stack need.
+static TableView DeterministicView(const Algo &parser) {
+    RequireCompleteTable(parser);
+    RequireDeterministicTable(parser);
+    return parser.View();
+}
+
+// Calls `function` with the table the parser runs on: the lazy one, the compressed one or the dense view.
+template<typename Function>
+static auto WithParseTable(const Algo &parser, Function function) {
+    if (parser.lazy_table) {
+        return function(*parser.lazy_table);
+    }
+    if (parser.compressed_table) {
+        return function(*parser.compressed_table);
+    }
+    return function(parser.View());
+}
+
+// Records production ids of the rightmost derivation in reverse order, the accepting one last.
+bool Algo::Parse(std::string_view input, ParseContext &context) const {
+    if (!table.conflicts.empty()) {
+        ParseForest forest;
+        context.reductions.clear();
+        return Parse(input, forest) && forest.FirstDerivation(context.reductions);
+    }
+    return WithParseTable(*this, [input, &context](const auto &table) {
+        return RunAutomaton<true>(table, input, context) == RecognizeResult::kNoError;
+    });
+}
+
+bool Algo::Parse(std::string_view input, ParseContext &context, const ReduceCallback &on_reduce) const {
+    RequireDeterministicTable(*this);
+    return WithParseTable(*this, [input, &context, &on_reduce](const auto &table) {
+        return ParseWithCallback(table, input, context, on_reduce);
+    });
+}
+
+Generator<ReduceEvent> Algo::ReduceEvents(std::string_view input) const {
+    RequireDeterministicTable(*this);
+    if (lazy_table) {
+        return GenerateReduceEvents(std::cref(*lazy_table), input);
+    }
+    if (compressed_table) {
+        return GenerateReduceEvents(std::cref(*compressed_table), input);
+    }
+    return GenerateReduceEvents(View(), input);
+}
+
+bool Algo::Parse(std::string_view input, ParseContext &context, ParseTree &tree) const {
+    RequireDeterministicTable(*this);
+    tree.Clear();
+    return WithParseTable(*this, [input, &context, &tree](const auto &table) {
+        ReduceEventCursor cursor(table, input, context, &tree);
+        ReduceEvent event{};
+        while (cursor.Next(event)) {
+        }
+        return cursor.Accepted();
+    });
+}
+
+bool Algo::Parse(std::string_view input, ParseForest &forest) const {
+    RequireCompleteTable(*this);
+    return GlrDriver(*this, &forest).Run(input) == RecognizeResult::kNoError;
+}
+
+RecognizeResult Algo::Recognize(std::string_view input, ParseContext &context) const {
+    if (!table.conflicts.empty()) {
+        auto error_offset = GlrDriver(*this, nullptr).Run(input);
+        return {error_offset == RecognizeResult::kNoError, error_offset};
+    }
+    auto error_offset = WithParseTable(*this, [input, &context](const auto &table) {
+        return RunAutomaton<false>(table, input, context);
+    });
+    return {error_offset == RecognizeResult::kNoError, error_offset};
+}
+
+RecognizeResult Algo::Recognize(std::string_view input) const {
+    ParseContext context;
+    return Recognize(input, context);
+}
+
+bool Algo::Predict(std::string input, std::vector<std::string> &derivation_rules) {
+    ParseContext context;
+    auto accepted = Parse(input, context);
+    for (auto production: context.reductions) {
+        derivation_rules.push_back(productions[production].rule);
+    }
+    return accepted;
+}
+
+std::shared_ptr<const CompiledParser> Algo::Compile() const {
+    RequireCompleteTable(*this);
+    RequireDeterministicTable(*this);
+    std::vector<std::string> rules;
+    for (auto &production: productions) {
+        rules.push_back(production.rule);
+    }
+    if (table_file) {
+        return std::make_shared<const CompiledParser>(table_file, table_file_view, std::move(rules));
+    }
+    return std::make_shared<const CompiledParser>(table, std::move(rules));
+}
+
+// Moves every state to new_id[state] and rebuilds the tables. The start state must stay 0.
+void Algo::RenumberStates(const std::vector<int> &new_id) {
+    RequireCompleteTable(*this);
+    if (states.empty()) {
+        throw std::logic_error("A parser loaded from a table file has no automaton to renumber.");
+    }
+    // Checked in full before anything moves, so a rejected renumbering leaves the parser as it was.
+    std::vector<bool> taken(states.size(), false);
+    auto is_permutation = new_id.size() == states.size() && new_id[0] == 0 &&
+                          std::all_of(new_id.begin(), new_id.end(), [&taken](int id) {
+                              if (id < 0 || static_cast<size_t>(id) >= taken.size() || taken[id]) {
+                                  return false;
+                              }
+                              taken[id] = true;
+                              return true;
+                          });
+    if (!is_permutation) {
+        throw std::invalid_argument("The renumbering must be a permutation of the states that keeps state 0.");
+    }
+    std::vector<State> renumbered_states(states.size(), State({}, kNoState));
+    for (size_t i = 0; i < states.size(); ++i) {
+        auto &state = renumbered_states[new_id[i]];
+        state = std::move(states[i]);
+        state.personal_id = new_id[i];
+        for (auto &transition: state.transitions) {
+            transition.second = new_id[transition.second];
+        }
+    }
+    states = std::move(renumbered_states);
+    for (auto &entry: state_index) {
+        entry.second = new_id[entry.second];
+    }
+    if (accept_state_id != kNoState) {
+        accept_state_id = new_id[accept_state_id];
+    }
+    MakeTable();
+    if (compressed_table) {
+        compressed_table = std::make_shared<const CompressedTable>(table.View(), productions.size());
+    }
+}
+
+// class LazyTable
+
+// The table works on its own copy of the grammar, so the Algo it came from may be moved or destroyed.
+static std::shared_ptr<const Algo> SnapshotGrammar(const Algo &parser) {
+    auto snapshot = std::make_shared<Algo>(parser);
+    snapshot->lazy_table.reset();
+    return snapshot;
+}
+
+LazyTable::LazyTable(const Algo &parser) :
+        grammar_(SnapshotGrammar(parser)),
+        chunks_(std::make_unique<std::atomic<LazyState *>[]>(kMaxChunks)) {
+    auto layout = EmptyTable(*grammar_, 0);
+    column = layout.column;
+    terminal_count = layout.terminal_count;
+    nonterminal_count = layout.nonterminal_count;
+    production_lengths = std::move(layout.production_lengths);
+    production_lhs = std::move(layout.production_lhs);
+    std::vector<Item> zero_state_set;
+    zero_state_set.emplace_back(0, 0, SymbolSet{kEndOfLine});
+    FindOrAddState(std::move(zero_state_set));
+    if (chunks_[0].load(std::memory_order_relaxed)[0].items.size() == 1) {
+        throw GrammarException("The grammar is incorrect. There are no reachable symbols.");
+    }
+}
+
+size_t LazyTable::StateCount() const {
+    std::lock_guard lock(mutex_);
+    return state_count_;
+}
+
+size_t LazyTable::BuiltRowCount() const {
+    std::lock_guard lock(mutex_);
+    return built_row_count_;
+}
+
+// Must be called with mutex_ held. The new slot is fully written before its id can reach any other thread,
+// which only happens through a row published after this call.
+int LazyTable::FindOrAddState(std::vector<Item> kernel) const {
+    std::sort(kernel.begin(), kernel.end());
+    auto fingerprint = State::Fingerprint(kernel);
+    if (auto state = state_index_.find(fingerprint); state != state_index_.end()) {
+        ++stats_.kernel_hits;
+        return state->second;
+    }
+    ++stats_.kernel_misses;
+    auto state = static_cast<int>(state_count_);
+    if ((state >> kChunkBits) >= kMaxChunks) {
+        throw GrammarException("The grammar has too many states for the lazy construction.");
+    }
+    auto &chunk = chunks_[state >> kChunkBits];
+    if (chunk.load(std::memory_order_relaxed) == nullptr) {
+        owned_chunks_.push_back(std::make_unique<LazyState[]>(kChunkSize));
+        chunk.store(owned_chunks_.back().get(), std::memory_order_release);
+    }
+    chunk.load(std::memory_order_relaxed)[state & (kChunkSize - 1)].items =
+            grammar_->Closure(std::move(kernel), core_closures_, stats_);
+    state_index_.emplace(std::move(fingerprint), state);
+    ++state_count_;
+    return state;
+}
+
+const LazyTable::Row &LazyTable::BuildRow(int state) const {
+    std::lock_guard lock(mutex_);
+    auto &lazy_state = chunks_[state >> kChunkBits].load(std::memory_order_relaxed)[state & (kChunkSize - 1)];
+    if (auto *row = lazy_state.row.load(std::memory_order_relaxed); row != nullptr) {
+        return *row;
+    }
+    std::map<char, int> transitions;
+    for (auto &[symbol, kernel]: grammar_->SuccessorKernels(lazy_state.items)) {
+        transitions[symbol] = FindOrAddState(std::move(kernel));
+    }
+    auto row = std::make_unique<Row>();
+    row->actions.assign(terminal_count, ParseTable::MakeAction(ActionType::kError));
+    row->gotos.assign(nonterminal_count, kNoState);
+    FillTableRow(*grammar_, column, lazy_state.items, transitions, row->actions.data(), row->gotos.data());
+    lazy_state.owned_row = std::move(row);
+    lazy_state.row.store(lazy_state.owned_row.get(), std::memory_order_release);
+    ++built_row_count_;
+    return *lazy_state.owned_row;
+}
+
+// class CompiledParser
+
+CompiledParser::CompiledParser(ParseTable parse_table, std::vector<std::string> production_rules) :
+        table_(std::move(parse_table)),
+        rules_(std::move(production_rules)) {
+}
+
+CompiledParser::CompiledParser(std::shared_ptr<const MappedFile> file,
+                               const TableView &file_view,
+                               std::vector<std::string> production_rules) :
+        table_file_(std::move(file)),
+        table_file_view_(file_view),
+        rules_(std::move(production_rules)) {
+}
+
+TableView CompiledParser::View() const {
+    return table_file_ ? table_file_view_ : table_.View();
+}
+
+const std::string &CompiledParser::Rule(int production) const {
+    return rules_[production];
+}
+
+bool CompiledParser::Parse(std::string_view input, ParseContext &context) const {
+    return RunAutomaton<true>(View(), input, context) == RecognizeResult::kNoError;
+}
+
+bool CompiledParser::Parse(std::string_view input, ParseContext &context, const ReduceCallback &on_reduce) const {
+    return ParseWithCallback(View(), input, context, on_reduce);
+}
+
+Generator<ReduceEvent> CompiledParser::ReduceEvents(std::string_view input) const {
+    return GenerateReduceEvents(View(), input);
+}
+
+RecognizeResult CompiledParser::Recognize(std::string_view input, ParseContext &context) const {
+    auto error_offset = RunAutomaton<false>(View(), input, context);
+    return {error_offset == RecognizeResult::kNoError, error_offset};
+}
+
+// function ParseBatch
+
+std::vector<RecognizeResult> ParseBatch(const CompiledParser &parser,
+                                        const std::vector<std::string> &words,
+                                        unsigned threads) {
+    std::vector<RecognizeResult> results(words.size());
+    if (words.empty()) {
+        return results;
+    }
+    std::atomic<size_t> next_chunk = 0;
+    auto worker = [&]() {
+        ParseContext context;
+        while (true) {
+            auto begin = next_chunk.fetch_add(kBatchChunkSize);
+            if (begin >= words.size()) {
+                return;
+            }
+            auto end = std::min(words.size(), begin + kBatchChunkSize);
+            for (auto i = begin; i < end; ++i) {
+                results[i] = parser.Recognize(words[i], context);
+            }
+        }
+    };
+    auto workers_number = std::clamp<size_t>(threads, 1, (words.size() + kBatchChunkSize - 1) / kBatchChunkSize);
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < workers_number; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread: pool) {
+        thread.join();
+    }
+    return results;
+}
+
+// class PushParser
+
+PushParser::PushParser(const TableView &table_view) : table_view_(table_view) {
+    stack_.reserve(ParseContext::kDefaultStackCapacity);
+    Reset();
+}
+
+PushParser::PushParser(const Algo &parser) : PushParser(DeterministicView(parser)) {
+}
+
+PushParser::PushParser(const CompiledParser &parser) : PushParser(parser.View()) {
+}
+
+void PushParser::Reset() {
+    stack_.assign(1, 0);
+    consumed_ = 0;
+    error_offset_ = RecognizeResult::kNoError;
+    pending_epsilon_ = false;
+    status_ = PushStatus::kNeedMoreInput;
+}
+
+PushStatus PushParser::Feed(std::string_view chunk) {
+    for (auto symbol: chunk) {
+        if (status_ != PushStatus::kNeedMoreInput) {
+            break;
+        }
+        // A word consisting of the single epsilon symbol is the empty word, which is only known at Finish.
+        if (consumed_ == 0 && symbol == kEpsilon && !pending_epsilon_) {
+            pending_epsilon_ = true;
+            continue;
+        }
+        if (pending_epsilon_) {
+            pending_epsilon_ = false;
+            Step(kEpsilon);
+            if (status_ != PushStatus::kNeedMoreInput) {
+                break;
+            }
+        }
+        if (symbol == kEndOfLine) {
+            error_offset_ = consumed_;
+            status_ = PushStatus::kRejected;
+            break;
+        }
+        Step(symbol);
+    }
+    return status_;
+}
+
+PushStatus PushParser::Finish() {
+    pending_epsilon_ = false;
+    if (status_ == PushStatus::kNeedMoreInput) {
+        Step(kEndOfLine);
+    }
+    if (status_ == PushStatus::kNeedMoreInput) {
+        error_offset_ = consumed_;
+        status_ = PushStatus::kRejected;
+    }
+    return status_;
+}
+
+// Feeding resumes exactly where the last chunk stopped, since the stack holds the whole driver state between steps.
+void PushParser::Step(char symbol) {
+    VectorStack stack(stack_);
+    switch (StepAutomaton(table_view_, table_view_.Column(symbol), stack, [](int) {})) {
+        case StepOutcome::kShifted:
+            ++consumed_;
+            break;
+        case StepOutcome::kAccepted:
+            status_ = PushStatus::kAccepted;
+            break;
+        case StepOutcome::kRejected:
+            error_offset_ = consumed_;
+            status_ = PushStatus::kRejected;
+    }
+}
+
+// class ParseSession
+
+ParseSession::ParseSession(const TableView &table_view, size_t checkpoint_interval) :
+        table_view_(table_view),
+        checkpoint_interval_(std::max<size_t>(checkpoint_interval, 1)) {
+    Reset({});
+}
+
+ParseSession::ParseSession(const Algo &parser, size_t checkpoint_interval) :
+        ParseSession(DeterministicView(parser), checkpoint_interval) {
+}
+
+ParseSession::ParseSession(const CompiledParser &parser, size_t checkpoint_interval) :
+        ParseSession(parser.View(), checkpoint_interval) {
+}
+
+RecognizeResult ParseSession::Reset(std::string text) {
+    text_ = std::move(text);
+    nodes_.assign(1, {0, kNoParent});
+    live_nodes_ = 1;
+    checkpoints_.assign(1, {0, 0, 1});
+    stale_.clear();
+    Run({}, {});
+    return result_;
+}
+
+RecognizeResult ParseSession::Edit(size_t offset, size_t erased, std::string_view inserted) {
+    if (offset > text_.size() || erased > text_.size() - offset) {
+        throw std::out_of_range("The edit lies outside the text.");
+    }
+    auto edit_end = offset + erased;
+    auto shifted = [erased, &inserted](size_t position) {
+        return position - erased + inserted.size();
+    };
+    text_.replace(offset, erased, inserted);
+
+    // A checkpoint stays a candidate for convergence only while the text after it is unchanged.
+    std::erase_if(stale_, [offset, edit_end](const Checkpoint &checkpoint) {
+        return checkpoint.offset <= offset || checkpoint.offset < edit_end;
+    });
+    for (auto &checkpoint: stale_) {
+        checkpoint.offset = shifted(checkpoint.offset);
+    }
+    if (!stale_.empty() && !stale_result_.accepted) {
+        stale_result_.error_offset = shifted(stale_result_.error_offset);
+    }
+    if (!result_.accepted && result_.error_offset < offset) {
+        // The text up to the error is unchanged, so is the error.
+        last_scanned_ = 0;
+        return result_;
+    }
+
+    auto resume = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), offset,
+                                   [](size_t position, const Checkpoint &checkpoint) {
+                                       return position < checkpoint.offset;
+                                   }) - 1;
+    std::vector<Checkpoint> tail;
+    for (auto checkpoint = resume + 1; checkpoint != checkpoints_.end(); ++checkpoint) {
+        if (checkpoint->offset >= edit_end) {
+            tail.push_back({shifted(checkpoint->offset), checkpoint->node, checkpoint->depth});
+        }
+    }
+    checkpoints_.erase(resume + 1, checkpoints_.end());
+    auto tail_result = result_;
+    if (!tail.empty() && !tail_result.accepted) {
+        tail_result.error_offset = shifted(tail_result.error_offset);
+    }
+    Run(std::move(tail), tail_result);
+    return result_;
+}
+
+// Stacks of equal depth are equal once their walks down reach a shared node; all of them share the root.
+bool ParseSession::SameStack(const Checkpoint &checkpoint, std::uint32_t top, std::uint32_t depth) const {
+    if (checkpoint.depth != depth) {
+        return false;
+    }
+    for (auto node = checkpoint.node; node != top; node = nodes_[node].parent, top = nodes_[top].parent) {
+        if (nodes_[node].state != nodes_[top].state) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs the automaton from the last checkpoint. tail holds the checkpoints of the previous run past the edit,
+// moved to their new offsets, and tail_result is where that run ended.
+void ParseSession::Run(std::vector<Checkpoint> tail, RecognizeResult tail_result) {
+    // Stack adapter over the node arena: pushes append a node, pops walk up to the parents.
+    struct ArenaStack {
+        std::vector<StackNode> &nodes;
+        std::uint32_t top;
+        std::uint32_t depth;
+
+        int Top() const {
+            return nodes[top].state;
+        }
+
+        void Pop(size_t count) {
+            for (; count > 0; --count) {
+                top = nodes[top].parent;
+                --depth;
+            }
+        }
+
+        void Push(int state) {
+            nodes.push_back({state, top});
+            top = static_cast<std::uint32_t>(nodes.size() - 1);
+            ++depth;
+        }
+    };
+
+    auto start = checkpoints_.back();
+    ArenaStack stack{nodes_, start.node, start.depth};
+    auto last_checkpoint = start.offset;
+    size_t tail_cursor = 0;
+    size_t stale_cursor = 0;
+    auto converges = [this, &stack](const std::vector<Checkpoint> &candidates, size_t &cursor, size_t position) {
+        while (cursor < candidates.size() && candidates[cursor].offset < position) {
+            ++cursor;
+        }
+        return cursor < candidates.size() && candidates[cursor].offset == position &&
+               SameStack(candidates[cursor], stack.top, stack.depth);
+    };
+
+    // A document consisting of the single epsilon symbol is the empty word, as in RunAutomaton.
+    std::string_view word = text_;
+    if (word.size() == 1 && word[0] == kEpsilon) {
+        word = {};
+    }
+    auto position = start.offset;
+    bool finished = false;
+    while (!finished) {
+        if (converges(tail, tail_cursor, position)) {
+            result_ = tail_result;
+            checkpoints_.insert(checkpoints_.end(), tail.begin() + static_cast<std::ptrdiff_t>(tail_cursor), tail.end());
+            break;
+        }
+        if (converges(stale_, stale_cursor, position)) {
+            result_ = stale_result_;
+            checkpoints_.insert(checkpoints_.end(), stale_.begin() + static_cast<std::ptrdiff_t>(stale_cursor),
+                                stale_.end());
+            stale_.clear();
+            break;
+        }
+        if (position - last_checkpoint >= checkpoint_interval_) {
+            checkpoints_.push_back({position, stack.top, stack.depth});
+            last_checkpoint = position;
+        }
+
+        auto symbol = position == word.size() ? kEndOfLine : word[position];
+        auto column = symbol == kEndOfLine && position != word.size() ? kNoColumn : table_view_.Column(symbol);
+        switch (StepAutomaton(table_view_, column, stack, [](int) {})) {
+            case StepOutcome::kShifted:
+                ++position;
+                break;
+            case StepOutcome::kAccepted:
+                result_ = {true, RecognizeResult::kNoError};
+                stale_.clear();
+                finished = true;
+                break;
+            case StepOutcome::kRejected:
+                result_ = {false, position};
+                // The old run went further; its checkpoints wait for the edit that repairs this error.
+                if (!tail.empty()) {
+                    stale_ = std::move(tail);
+                    stale_result_ = tail_result;
+                }
+                finished = true;
+        }
+    }
+    last_scanned_ = position - start.offset;
+    if (nodes_.size() > 2 * live_nodes_ + kMinArenaSize) {
+        CompactNodes();
+    }
+}
+
+// Drops the nodes no checkpoint reaches. Parents are older than their children, so one pass in index order
+// can renumber them.
+void ParseSession::CompactNodes() {
+    std::vector<std::uint32_t> new_index(nodes_.size(), kNoParent);
+    for (auto *checkpoints: {&checkpoints_, &stale_}) {
+        for (auto &checkpoint: *checkpoints) {
+            for (auto node = checkpoint.node; node != kNoParent && new_index[node] == kNoParent;
+                 node = nodes_[node].parent) {
+                new_index[node] = 0;
+            }
+        }
+    }
+    std::uint32_t live = 0;
+    for (size_t node = 0; node < nodes_.size(); ++node) {
+        if (new_index[node] == kNoParent) {
+            continue;
+        }
+        auto parent = nodes_[node].parent;
+        nodes_[live] = {nodes_[node].state, parent == kNoParent ? kNoParent : new_index[parent]};
+        new_index[node] = live++;
+    }
+    nodes_.resize(live);
+    for (auto *checkpoints: {&checkpoints_, &stale_}) {
+        for (auto &checkpoint: *checkpoints) {
+            checkpoint.node = new_index[checkpoint.node];
+        }
+    }
+    live_nodes_ = live;
+}
+
+// class DerivationView
+
+DerivationView::DerivationView(const Algo &parser, std::vector<int> reductions) :
+        parser_(parser),
+        reductions_(std::move(reductions)) {
+}
+
+// In a rightmost derivation everything after the rightmost nonterminal is terminal, so the sentential form is kept
+// as a prefix ending at that nonterminal plus the reversed terminal suffix, and every step only touches the end
+// of the prefix.
+std::string DerivationView::ToString() const {
+    if (reductions_.empty()) {
+        return {};
+    }
+    std::string derivation{kRealStart};
+    std::string prefix{parser_.productions[reductions_.back()].symbols};
+    std::string reversed_suffix;
+    derivation += "->" + prefix;
+    auto is_nonterminal = [](char symbol) {
+        return symbol >= kNonTerminalAlphabetBeg && symbol <= kNonTerminalAlphabetEnd;
+    };
+    for (auto i = static_cast<int>(reductions_.size()) - 2; i >= 0; --i) {
+        while (!prefix.empty() && !is_nonterminal(prefix.back())) {
+            reversed_suffix += prefix.back();
+            prefix.pop_back();
+        }
+        if (prefix.empty()) {
+            break;
+        }
+        prefix.pop_back();
+        prefix += parser_.productions[reductions_[i]].symbols;
+        derivation += "->";
+        derivation += prefix;
+        derivation.append(reversed_suffix.rbegin(), reversed_suffix.rend());
+    }
+    return derivation;
+}
+
+// class ParseTree
+
+void ParseTree::Save(const std::string &path) const {
+    static_assert(std::endian::native == std::endian::little, "Parse tree files are little-endian.");
+    ParseTreeFileHeader header{};
+    std::memcpy(header.magic, kParseTreeFileMagic, sizeof(header.magic));
+    header.version = kParseTreeFileVersion;
+    header.node_size = sizeof(ParseTreeNode);
+    header.node_count = nodes.size();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw TableFileException("Cannot create the parse tree file.");
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(nodes.data()),
+              static_cast<std::streamsize>(nodes.size() * sizeof(ParseTreeNode)));
+    if (!out) {
+        throw TableFileException("Cannot write the parse tree file.");
+    }
+}
+
+// function MapParseTree
+
+ParseTreeView MapParseTree(const std::string &path) {
+    auto file = std::make_shared<const MappedFile>(path);
+    ParseTreeFileHeader header{};
+    if (file->size() < sizeof(header)) {
+        throw TableFileException("The file is not a parse tree file.");
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, kParseTreeFileMagic, sizeof(header.magic)) != 0) {
+        throw TableFileException("The file is not a parse tree file.");
+    }
+    if (header.version != kParseTreeFileVersion || header.node_size != sizeof(ParseTreeNode)) {
+        throw TableFileException("Unsupported parse tree file version.");
+    }
+    if (file->size() != sizeof(header) + header.node_count * sizeof(ParseTreeNode)) {
+        throw TableFileException("The parse tree file is truncated.");
+    }
+    // mmap returns page-aligned memory and the header size keeps the nodes aligned.
+    static_assert(sizeof(ParseTreeFileHeader) % alignof(ParseTreeNode) == 0);
+    auto nodes = reinterpret_cast<const ParseTreeNode *>(file->data() + sizeof(header));
+    return {std::span<const ParseTreeNode>(nodes, header.node_count), std::move(file)};
+}
+
+// class ParseForest
+
+void ParseForest::Clear() {
+    nodes.clear();
+    alternatives.clear();
+    children.clear();
+    root = kNoNode;
+}
+
+bool ParseForest::IsAmbiguous() const {
+    if (root == kNoNode) {
+        return false;
+    }
+    std::vector<bool> visited(nodes.size(), false);
+    std::vector<int> pending{root};
+    visited[root] = true;
+    while (!pending.empty()) {
+        auto node = pending.back();
+        pending.pop_back();
+        auto first = nodes[node].first_alternative;
+        if (first != kNoNode && alternatives[first].next != kNoNode) {
+            return true;
+        }
+        for (auto alternative = first; alternative != kNoNode; alternative = alternatives[alternative].next) {
+            auto begin = children.begin() + alternatives[alternative].first_child;
+            for (auto child = begin; child != begin + alternatives[alternative].child_count; ++child) {
+                if (!visited[*child]) {
+                    visited[*child] = true;
+                    pending.push_back(static_cast<int>(*child));
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Post-order count over the forest. Meeting a node whose count is still open means a cycle, so there are
+// infinitely many trees.
+std::uint64_t ParseForest::CountTrees() const {
+    auto const infinite = std::numeric_limits<std::uint64_t>::max();
+    if (root == kNoNode) {
+        return 0;
+    }
+    enum class Mark : std::uint8_t { kNew, kOpen, kDone };
+    std::vector<Mark> marks(nodes.size(), Mark::kNew);
+    std::vector<std::uint64_t> counts(nodes.size(), 0);
+    std::vector<int> pending{root};
+    while (!pending.empty()) {
+        auto node = pending.back();
+        if (marks[node] == Mark::kDone) {
+            pending.pop_back();
+            continue;
+        }
+        auto first = nodes[node].first_alternative;
+        if (marks[node] == Mark::kNew) {
+            marks[node] = Mark::kOpen;
+            for (auto alternative = first; alternative != kNoNode; alternative = alternatives[alternative].next) {
+                auto begin = children.begin() + alternatives[alternative].first_child;
+                for (auto child = begin; child != begin + alternatives[alternative].child_count; ++child) {
+                    if (marks[*child] == Mark::kOpen) {
+                        return infinite;
+                    }
+                    if (marks[*child] == Mark::kNew) {
+                        pending.push_back(static_cast<int>(*child));
+                    }
+                }
+            }
+            continue;
+        }
+        std::uint64_t count = first == kNoNode ? 1 : 0;
+        for (auto alternative = first; alternative != kNoNode; alternative = alternatives[alternative].next) {
+            std::uint64_t product = 1;
+            auto begin = children.begin() + alternatives[alternative].first_child;
+            for (auto child = begin; child != begin + alternatives[alternative].child_count; ++child) {
+                product = counts[*child] != 0 && product > infinite / counts[*child] ? infinite
+                                                                                      : product * counts[*child];
+            }
+            count = count > infinite - product ? infinite : count + product;
+        }
+        counts[node] = count;
+        marks[node] = Mark::kDone;
+        pending.pop_back();
+    }
+    return counts[root];
+}
+
+// Follows the first alternative of every node, which the GLR driver keeps acyclic, and lists the inner nodes
+// in post-order.
+bool ParseForest::FirstDerivation(std::vector<int> &reductions) const {
+    reductions.clear();
+    if (root == kNoNode) {
+        return false;
+    }
+    std::vector<std::pair<int, std::uint32_t>> pending{{root, 0}};
+    while (!pending.empty()) {
+        auto [node, next_child] = pending.back();
+        auto &alternative = alternatives[nodes[node].first_alternative];
+        if (next_child == alternative.child_count) {
+            reductions.push_back(alternative.production);
+            pending.pop_back();
+            continue;
+        }
+        ++pending.back().second;
+        auto child = static_cast<int>(children[alternative.first_child + next_child]);
+        if (nodes[child].first_alternative != kNoNode) {
+            pending.emplace_back(child, 0);
+        }
+    }
+    return true;
+}
+
+// function ProfileStates
+
+StateProfile ProfileStates(const Algo &parser, const std::vector<std::string> &corpus) {
+    RequireCompleteTable(parser);
+    RequireDeterministicTable(parser);
+    struct ProfileObserver {
+        StateProfile *profile;
+
+        void Enter(int from, int to) const {
+            ++profile->visits[to];
+            if (from != kNoState) {
+                ++profile->transitions[{from, to}];
+            }
+        }
+    };
+
+    StateProfile profile;
+    profile.visits.assign(parser.View().state_count, 0);
+    ParseContext context;
+    for (auto &word: corpus) {
+        RunAutomaton<false>(parser.View(), word, context, ProfileObserver{&profile});
+    }
+    return profile;
+}
+
+// function ProfileGuidedOrder
+
+// Greedy chain placement: starting from state 0, keep appending the most frequent not yet placed successor
+// of the last placed state; when there is none, continue from the hottest state left. Hot rows and their usual
+// successors end up next to each other, and states the corpus never reached go last in their old order.
+std::vector<int> ProfileGuidedOrder(const StateProfile &profile) {
+    auto states_number = profile.visits.size();
+    std::vector<std::vector<std::pair<std::uint64_t, int>>> successors(states_number);
+    for (auto &[transition, count]: profile.transitions) {
+        successors[transition.first].emplace_back(count, transition.second);
+    }
+    for (auto &state_successors: successors) {
+        std::stable_sort(state_successors.begin(), state_successors.end(), [](const auto &first, const auto &second) {
+            return first.first > second.first;
+        });
+    }
+    std::vector<int> by_visits(states_number);
+    for (size_t i = 0; i < states_number; ++i) {
+        by_visits[i] = static_cast<int>(i);
+    }
+    std::stable_sort(by_visits.begin(), by_visits.end(), [&profile](int first, int second) {
+        return profile.visits[first] > profile.visits[second];
+    });
+
+    std::vector<int> new_id(states_number, kNoState);
+    int placed = 0;
+    auto next_hottest = by_visits.begin();
+    auto current = 0;
+    while (current != kNoState) {
+        new_id[current] = placed++;
+        auto next = kNoState;
+        for (auto &successor: successors[current]) {
+            if (new_id[successor.second] == kNoState) {
+                next = successor.second;
+                break;
+            }
+        }
+        while (next == kNoState && next_hottest != by_visits.end()) {
+            if (new_id[*next_hottest] == kNoState) {
+                next = *next_hottest;
+            }
+            ++next_hottest;
+        }
+        current = next;
+    }
+    return new_id;
+}
+
+// function CalculateDerivation
+
+std::string CalculateDerivation(const std::vector<std::string> &derivation_rules) {
+    std::string derivation = std::string{kRealStart};
+    std::string delimiter = "->";
+    derivation += delimiter + derivation_rules[derivation_rules.size() - 1][3];
+    for (int i = derivation_rules.size() - 2; i >= 0; --i) {
+        auto delimiter_pos = derivation.rfind(delimiter);
+        auto rule_to_replace = derivation.substr(delimiter_pos + 2);
+        auto nonterm_to_replace = rule_to_replace.rfind(derivation_rules[i][0]);
+        auto part_after_nonterm = rule_to_replace.substr(nonterm_to_replace + 1);
+        rule_to_replace = rule_to_replace.substr(0, nonterm_to_replace);
+        delimiter_pos = derivation_rules[i].find(delimiter);
+        auto expansion = derivation_rules[i].substr(delimiter_pos + 2);
+        rule_to_replace += (expansion + part_after_nonterm);
+        derivation += delimiter + rule_to_replace;
+    }
+    return derivation;
+}
+
+// Inner nodes in post-order are exactly the reductions in the order Parse performs them.
+std::string CalculateDerivation(const Algo &parser, const ParseTreeView &tree) {
+    std::vector<int> reductions;
+    for (auto &node: tree.nodes) {
+        if (node.production != ParseTree::kTokenNode) {
+            reductions.push_back(node.production);
+        }
+    }
+    return DerivationView(parser, std::move(reductions)).ToString();
+}
+
+void PrintStates(const Algo &parser) {
+    std::cout << "Automaton states:" << '\n';
+    for (const auto &state: parser.states) {
+        if (state.personal_id == parser.accept_state_id) {
+            std::cout << "Accept state " << state.personal_id << '\n';
+        } else {
+            std::cout << "State " << state.personal_id << '\n';
+        }
+        for (auto &item: state.items) {
+            std::cout << "(" << parser.ItemToString(item) << "|";
+            auto separator = "";
+            for (auto symbol: item.lookaheads) {
+                std::cout << separator << symbol;
+                separator = ", ";
+            }
+            std::cout << ")" << '\n';
+        }
+        std::cout << '\n';
+        for (auto j: state.transitions) {
+            if (parser.terminals.contains(j.first)) {
+                std::cout << "By terminal " << j.first << " shift to state " << j.second << '\n';
+            } else {
+                std::cout << "By nonterminal " << j.first << " go to state " << j.second << '\n';
+            }
+        }
+        std::cout << '\n';
+    }
+}
+
+static std::string CellToString(const Algo &parser, char symbol, int state) {
+    auto table_view = parser.View();
+    auto column = table_view.Column(symbol);
+    if (parser.nonterminals.contains(symbol)) {
+        auto next_state = table_view.Goto(state, column);
+        return next_state == kNoState ? " " : std::to_string(next_state);
+    }
+    auto action = table_view.Action(state, column);
+    switch (ParseTable::TypeOf(action)) {
+        case ActionType::kShift:
+            return std::to_string(ParseTable::ValueOf(action));
+        case ActionType::kReduce:
+            return parser.productions[ParseTable::ValueOf(action)].rule;
+        case ActionType::kAccept:
+            return parser.productions[0].rule;
+        case ActionType::kConflict: {
+            std::string cell;
+            for (auto conflicting: parser.table.conflicts[ParseTable::ValueOf(action)]) {
+                auto value = ParseTable::ValueOf(conflicting);
+                cell += cell.empty() ? "" : "/";
+                cell += ParseTable::TypeOf(conflicting) == ActionType::kShift ? std::to_string(value)
+                                                                               : parser.productions[value].rule;
+            }
+            return cell;
+        }
+        default:
+            return " ";
+    }
+}
+
+void PrintTable(const Algo &parser) {
+    std::cout << std::setw(25) << std::left << "States/Symbols";
+
+    for (const auto terminal: parser.terminals) {
+        if (terminal == kEpsilon) {
+            continue;
+        }
+        std::cout << std::setw(15) << std::left << terminal;
+    }
+
+    std::cout << std::setw(15) << std::left << kEndOfLine;
+
+    for (const auto &nonterminal: parser.nonterminals) {
+        if (nonterminal.first == kRealStart) {
+            continue;
+        }
+        std::cout << std::setw(15) << std::left << nonterminal.first;
+    }
+    std::cout << '\n';
+
+    for (size_t i = 0; i < parser.View().state_count; ++i) {
+        auto state = static_cast<int>(i);
+        std::cout << "State " << std::setw(19) << std::left << i;
+        for (const auto terminal: parser.terminals) {
+            if (terminal == kEpsilon) {
+                continue;
+            }
+            std::cout << std::setw(15) << std::left << CellToString(parser, terminal, state);
+        }
+
+        std::cout << std::setw(15) << std::left << CellToString(parser, kEndOfLine, state);
+
+        for (const auto &nonterminal: parser.nonterminals) {
+            if (nonterminal.first == kRealStart) {
+                continue;
+            }
+            std::cout << std::setw(15) << std::left << CellToString(parser, nonterminal.first, state);
+        }
+        std::cout << '\n';
+    }
+    std::cout << '\n';
+}
+
+void SaveTable(const Algo &parser, const std::string &path) {
+    RequireCompleteTable(parser);
+    RequireDeterministicTable(parser);
+    auto table_view = parser.View();
+    auto align = [](std::uint64_t offset) {
+        return (offset + 7) / 8 * 8;
+    };
+    TableFileHeader header{};
+    std::memcpy(header.magic, kTableFileMagic, sizeof(header.magic));
+    header.version = kTableFileVersion;
+    header.state_count = static_cast<std::uint32_t>(table_view.state_count);
+    header.terminal_count = static_cast<std::uint32_t>(table_view.terminal_count);
+    header.nonterminal_count = static_cast<std::uint32_t>(table_view.nonterminal_count);
+    header.production_count = static_cast<std::uint32_t>(parser.productions.size());
+    header.accept_state = parser.accept_state_id;
+    header.grammar_hash = parser.GrammarHash();
+    header.columns_offset = align(sizeof(TableFileHeader));
+    header.actions_offset = align(header.columns_offset + 256 * sizeof(std::int32_t));
+    header.gotos_offset = align(header.actions_offset +
+                                table_view.state_count * table_view.terminal_count * sizeof(std::uint32_t));
+    header.lengths_offset = align(header.gotos_offset +
+                                  table_view.state_count * table_view.nonterminal_count * sizeof(std::int32_t));
+    header.lhs_offset = align(header.lengths_offset + header.production_count * sizeof(std::uint32_t));
+    header.file_size = align(header.lhs_offset + header.production_count * sizeof(std::int32_t));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw TableFileException("Cannot create the parse table file.");
+    }
+    auto pad_to = [&out](std::uint64_t offset) {
+        while (static_cast<std::uint64_t>(out.tellp()) < offset) {
+            out.put('\0');
+        }
+    };
+    out.write(header.magic, sizeof(header.magic));
+    WriteLittleEndian(out, header.version);
+    WriteLittleEndian(out, header.state_count);
+    WriteLittleEndian(out, header.terminal_count);
+    WriteLittleEndian(out, header.nonterminal_count);
+    WriteLittleEndian(out, header.production_count);
+    WriteLittleEndian(out, header.accept_state);
+    WriteLittleEndian(out, header.grammar_hash);
+    WriteLittleEndian(out, header.columns_offset);
+    WriteLittleEndian(out, header.actions_offset);
+    WriteLittleEndian(out, header.gotos_offset);
+    WriteLittleEndian(out, header.lengths_offset);
+    WriteLittleEndian(out, header.lhs_offset);
+    WriteLittleEndian(out, header.file_size);
+    pad_to(header.columns_offset);
+    WriteLittleEndian(out, table_view.column, 256);
+    pad_to(header.actions_offset);
+    WriteLittleEndian(out, table_view.actions, table_view.state_count * table_view.terminal_count);
+    pad_to(header.gotos_offset);
+    WriteLittleEndian(out, table_view.gotos, table_view.state_count * table_view.nonterminal_count);
+    pad_to(header.lengths_offset);
+    WriteLittleEndian(out, table_view.production_lengths, header.production_count);
+    pad_to(header.lhs_offset);
+    WriteLittleEndian(out, table_view.production_lhs, header.production_count);
+    pad_to(header.file_size);
+    if (!out) {
+        throw TableFileException("Cannot write the parse table file.");
+    }
+}